@@ -0,0 +1,359 @@
+//  file: bench_tick.c
+//  Tick-path microbenchmark for countdown.c, run on the host
+//
+//  countdown.c is compiled straight into this file (its main() renamed)
+//  so the static handlers can be driven directly.  For each kind of
+//  rollover we feed seconds_handler() the unit mask the tick timer
+//  service would, advance the stub clock by the matching step, draw the
+//  frame it caused, and report wall time, dirty area and SDK calls per
+//  tick.
+//
+//  usage: countdown-bench [iterations]
+
+#define main countdown_main
+#include "../src/countdown.c"
+#undef main
+
+// 2015-05-30 00:00:00 UTC, a few days after the first real event starts
+#define BENCH_EPOCH 1432944000
+// ticks before the clock goes back to BENCH_EPOCH
+#define BENCH_WRAP  1000
+
+typedef struct {
+  const char *name;
+  time_t      step;
+  TimeUnits   units;
+} bench_case;
+
+static const bench_case bench_cases[] = {
+  { "second", 1,        SECOND_UNIT                                     },
+  { "minute", 60,       SECOND_UNIT | MINUTE_UNIT                       },
+  { "hour",   60*60,    SECOND_UNIT | MINUTE_UNIT | HOUR_UNIT           },
+  { "day",    60*60*24, SECOND_UNIT | MINUTE_UNIT | HOUR_UNIT | DAY_UNIT },
+};
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + (uint64_t)ts.tv_nsec;
+}
+
+static void run_case(const bench_case *c, unsigned long iterations)
+{
+  time_t t = BENCH_EPOCH;
+  struct tm tick_time;
+  uint64_t elapsed = 0;
+  uint64_t dirty_pixels = 0;
+
+  stub_set_time(t);
+  choose_event(t);
+  stub_render();
+  stub_reset_counters();
+
+  for (unsigned long i = 0; i < iterations; ++i) {
+    // stay within a few years of the schedule
+    t = BENCH_EPOCH + (i % BENCH_WRAP + 1) * c->step;
+    stub_set_time(t);
+    localtime_r(&t, &tick_time);
+
+    uint64_t start = now_ns();
+    seconds_handler(&tick_time, c->units);
+    dirty_pixels += face_dirty.size.w * face_dirty.size.h;
+    stub_render();
+    elapsed += now_ns() - start;
+  }
+
+  double n = (double)iterations;
+  printf("%-8s %10.1f %9.2f %9.0f %9.2f %9.2f %9.2f %9.2f %9.2f %9.2f\n",
+         c->name, elapsed / n,
+         stub_counters.frames / n,
+         dirty_pixels / n,
+         stub_counters.draw_text / n,
+         stub_counters.draw_bitmap / n,
+         (stub_counters.persist_exists + stub_counters.persist_reads) / n,
+         stub_counters.persist_writes / n,
+         stub_counters.localtime / n,
+         stub_counters.time / n);
+}
+
+// the face's refresh policy, but counting the watch idle after minutes
+static void set_idle_minutes(uint16_t minutes)
+{
+  RefreshConfig config = {
+    .low_battery_percent    = REFRESH_LOW_BATTERY,
+    .slow_when_disconnected = REFRESH_SLOW_DISCONNECTED,
+    .tap_wake_seconds       = REFRESH_TAP_WAKE_SECONDS,
+    .idle_minutes           = minutes,
+  };
+  refresh_deinit();
+  refresh_init(&config, seconds_handler, refresh_mode_changed);
+}
+
+// one simulated hour of system ticks through the refresh policy, with a
+// wrist tap tap_at seconds in if that isn't 0
+static void run_policy_case(const char *name, BatteryChargeState charge, bool connected,
+                            int tap_at)
+{
+  time_t t = BENCH_EPOCH + 60*60;
+  struct tm tick_time;
+
+  stub_battery_event(charge);
+  stub_bluetooth_event(connected);
+  uint32_t avoided = refresh_wakeups_avoided();
+  stub_reset_counters();
+
+  for (int i = 0; i < 60*60; ++i) {
+    t += 1;
+    stub_set_time(t);
+    localtime_r(&t, &tick_time);
+    TimeUnits units = SECOND_UNIT;
+    if (tick_time.tm_sec == 0) units |= MINUTE_UNIT;
+    if (units & MINUTE_UNIT && tick_time.tm_min == 0) units |= HOUR_UNIT;
+    stub_tick(&tick_time, units);
+    if (i+1 == tap_at) stub_tap_event();
+    stub_run_timers();
+    stub_render();
+  }
+
+  printf("%-12s %-7s %8lu %8lu\n", name, refresh_units() == SECOND_UNIT ? "second" : "minute",
+         (unsigned long)stub_counters.frames,
+         (unsigned long)(refresh_wakeups_avoided() - avoided));
+}
+
+static void print_startup(const char *name, const char *stage)
+{
+  char label[32];
+  snprintf(label, sizeof(label), "%s, %s", name, stage);
+  printf("%-22s %8lu %8lu %8lu %8lu %9lu\n", label,
+         (unsigned long)stub_counters.frames, (unsigned long)stub_counters.resource_loads,
+         (unsigned long)(stub_counters.persist_exists + stub_counters.persist_reads),
+         (unsigned long)stub_counters.persist_writes, (unsigned long)heap_bytes_used());
+}
+
+// SDK calls up to the first frame, and once the deferred stages have run
+static void run_startup(const char *name, time_t now)
+{
+  stub_set_time(now);
+  stub_reset_counters();
+  handle_init();
+  stub_render();
+  print_startup(name, "first frame");
+  stub_run_timers();
+  stub_render();
+  print_startup(name, "all stages");
+}
+
+// Drive the outbox pump: complete each message it sends with the next
+// of results (then APP_MSG_OK), a second of watch time at a time so
+// retries come due.  A NOT_CONNECTED phone comes back straight away.
+static void run_outbox_case(const char *name, unsigned int requests,
+                            const AppMessageResult *results, unsigned int n_results)
+{
+  time_t t = stub_get_time();
+  unsigned int next = 0;
+  size_t bytes = 0;
+
+  stub_reset_counters();
+  for (unsigned int i = 0; i < requests; ++i) outbox_request(ACTION_SETTINGS);
+  for (unsigned int second = 0; second < 60; ++second) {
+    while (stub_app_message_pending()) {
+      AppMessageResult result = (next < n_results) ? results[next++] : APP_MSG_OK;
+      bytes = stub_app_message_size();
+      stub_app_message_complete(result);
+      if (result == APP_MSG_NOT_CONNECTED) outbox_connected(true);
+    }
+    stub_set_time(++t);
+    stub_run_timers();
+  }
+  printf("%-22s %8u %8lu %8lu %8lu\n", name, requests, (unsigned long)stub_counters.app_messages,
+         (unsigned long)stub_counters.timers_fired, (unsigned long)bytes);
+}
+
+// The phone's end of the event stream, as pebble-js-app.js does it, over
+// a catalog of events one a week from BENCH_EPOCH, each event's id one of
+// the ten settings, and the "MINI" event after them.
+#define BENCH_STREAM_VERSION 0x5EED
+
+static uint16_t stream_catalog;
+static unsigned long stream_chunks, stream_bytes;
+
+static void phone_event(uint16_t seq, StreamEvent *event)
+{
+  memset(event, 0, sizeof(*event));
+  if (seq+1 == stream_catalog) {
+    // 9999-12-30, as in events.json
+    *event = (StreamEvent){ .day = 2932895, .id = 255, .name = "MINI" };
+    return;
+  }
+  event->day    = BENCH_EPOCH/(24*60*60) + seq * 7;
+  event->id     = 1 + seq % 10;
+  event->length = 2;
+  snprintf(event->name, sizeof(event->name), "EVENT%u", seq);
+}
+
+// answer every message the watch has sent, until it stops asking
+static void phone_answer(void)
+{
+  while (stub_app_message_pending()) {
+    const Tuple *tuple = stub_app_message_find(STREAM_CURSOR_KEY);
+    const Tuple *action = stub_app_message_find(ACTION_KEY);
+    StreamCursor cursor = { 0 };
+    if (tuple) memcpy(&cursor, tuple->value->data, sizeof(cursor));
+    bool asked = action && (action->value->uint8 == ACTION_EVENTS);
+    stub_app_message_complete(APP_MSG_OK);
+    if (!tuple) continue;
+
+    uint8_t chunk[STREAM_CHUNK_SIZE];
+    StreamChunkHeader header = { BENCH_STREAM_VERSION, cursor.next, 0, 0 };
+    if ((cursor.version != BENCH_STREAM_VERSION) || (cursor.next == STREAM_SEQ_FIRST)) {
+      // the first event not over
+      time_t now = stub_get_time();
+      header.first = 0;
+      while ((header.first+1 < stream_catalog) &&
+             (BENCH_EPOCH + header.first * 7*24*60*60 + 3*24*60*60 <= now))
+        ++header.first;
+      header.flags |= STREAM_RESET;
+    }
+    while ((header.count < cursor.want) && (header.count < STREAM_CHUNK) &&
+           (header.first + header.count < stream_catalog)) {
+      phone_event(header.first + header.count,
+                  (StreamEvent *)(chunk + sizeof(header)) + header.count);
+      ++header.count;
+    }
+    if (header.first + header.count >= stream_catalog) header.flags |= STREAM_LAST;
+    if (!(header.flags & STREAM_RESET) && (header.count == 0) && !asked) continue;
+
+    memcpy(chunk, &header, sizeof(header));
+    uint16_t size = sizeof(header) + header.count * sizeof(StreamEvent);
+    ++stream_chunks;
+    stream_bytes += size;
+    stub_app_sync_receive_bytes(STREAM_CHUNK_KEY, chunk, size);
+  }
+}
+
+// A year of days from a fresh start, the phone streaming from a catalog
+// of this many events, then a restart from what the ring persisted
+static void run_stream_case(uint16_t catalog)
+{
+  time_t t = BENCH_EPOCH;
+  struct tm tick_time;
+
+  handle_deinit();
+  stub_app_message_close();
+  stub_persist_clear();
+  stub_bluetooth_event(true);
+  stream_catalog = catalog + 1;
+  stream_chunks = stream_bytes = 0;
+  stub_set_time(t);
+  stub_reset_counters();
+  handle_init();
+
+  size_t heap_max = 0;
+  for (int day = 0; day <= 365; ++day) {
+    if (day > 0) {
+      t += 24*60*60;
+      stub_set_time(t);
+      localtime_r(&t, &tick_time);
+      stub_tick(&tick_time, SECOND_UNIT | MINUTE_UNIT | HOUR_UNIT | DAY_UNIT);
+    }
+    // a second at a time so the sync settle timer fires
+    for (int second = 0; second < 2; ++second) {
+      stub_run_timers();
+      phone_answer();
+      stub_set_time(++t);
+    }
+    if (heap_bytes_used() > heap_max) heap_max = heap_bytes_used();
+  }
+  uint32_t messages = stub_counters.app_messages;
+  char shown[sizeof(event_name_buffer)];
+  strncpy(shown, event_name_buffer, sizeof(shown));
+
+  // back with the ring as it was written on the way out
+  unsigned long chunks = stream_chunks;
+  handle_deinit();
+  stub_app_message_close();
+  uint32_t writes = stub_counters.persist_writes;
+  handle_init();
+  choose_event(t);
+  printf("%-8u %8lu %8lu %8lu %8lu %9lu %8u %-10s %s\n", catalog, (unsigned long)messages, chunks,
+         stream_bytes, (unsigned long)writes, (unsigned long)heap_max, catalog_count() - 1,
+         shown, strcmp(shown, event_name_buffer) == 0 ? "same" : event_name_buffer);
+}
+
+int main(int argc, char **argv)
+{
+  unsigned long iterations = argc > 1 ? strtoul(argv[1], NULL, 10) : 100000;
+  if (iterations == 0) iterations = 1;
+
+  // keep localtime() deterministic between hosts
+  setenv("TZ", "UTC", 1);
+  tzset();
+
+  printf("startup stages\n");
+  printf("%-22s %8s %8s %8s %8s %9s\n", "case", "frames", "res_load", "p_read", "p_write",
+         "heap_used");
+  stub_persist_clear();
+  run_startup("cold", BENCH_EPOCH);
+  // again with the face state and render snapshot the first run saved
+  handle_deinit();
+  stub_app_message_close();
+  run_startup("warm", BENCH_EPOCH);
+  // a day later the snapshot is stale and the event is chosen again
+  handle_deinit();
+  stub_app_message_close();
+  run_startup("stale", BENCH_EPOCH + 24*60*60);
+  stub_set_time(BENCH_EPOCH);
+
+  printf("\nheap after init: %lu bytes used, %lu free\n",
+         (unsigned long)heap_bytes_used(), (unsigned long)heap_bytes_free());
+  printf("app message buffers: %lu in, %lu out (maximum %lu, %lu)\n\n",
+         (unsigned long)INBOX_SIZE, (unsigned long)ACTION_OUTBOX_SIZE,
+         (unsigned long)app_message_inbox_size_maximum(),
+         (unsigned long)app_message_outbox_size_maximum());
+
+  // the phone acks the action startup sent
+  stub_app_message_complete(APP_MSG_OK);
+  printf("outbox pump\n");
+  printf("%-22s %8s %8s %8s %8s\n", "case", "requests", "sent", "retries", "bytes");
+  run_outbox_case("acked", 1, NULL, 0);
+  run_outbox_case("3 requests merged", 3, NULL, 0);
+  static const AppMessageResult nack_twice[] = { APP_MSG_SEND_REJECTED, APP_MSG_SEND_TIMEOUT };
+  run_outbox_case("nack, timeout", 1, nack_twice, ARRAY_LENGTH(nack_twice));
+  static const AppMessageResult nack_always[] = {
+    APP_MSG_SEND_REJECTED, APP_MSG_SEND_REJECTED, APP_MSG_SEND_REJECTED,
+    APP_MSG_SEND_REJECTED, APP_MSG_SEND_REJECTED, APP_MSG_SEND_REJECTED,
+  };
+  run_outbox_case("nack until dropped", 1, nack_always, ARRAY_LENGTH(nack_always));
+  static const AppMessageResult disconnected[] = { APP_MSG_NOT_CONNECTED };
+  run_outbox_case("phone away, back", 1, disconnected, ARRAY_LENGTH(disconnected));
+  stub_set_time(BENCH_EPOCH);
+  printf("\n");
+  printf("countdown tick path, %lu ticks per case\n", iterations);
+  printf("%-8s %10s %9s %9s %9s %9s %9s %9s %9s %9s\n", "case", "ns/tick", "frames",
+         "dirty_px", "draw_txt", "draw_bmp", "p_read", "p_write", "localtime", "time");
+  for (unsigned int i = 0; i < ARRAY_LENGTH(bench_cases); ++i) {
+    run_case(&bench_cases[i], iterations);
+  }
+
+  printf("\nrefresh policy, one hour of ticks\n");
+  printf("%-12s %-7s %8s %8s\n", "case", "unit", "frames", "avoided");
+  run_policy_case("normal",       (BatteryChargeState){ 70, false, false }, true, 0);
+  run_policy_case("low battery",  (BatteryChargeState){ 10, false, false }, true, 0);
+  run_policy_case("disconnected", (BatteryChargeState){ 70, false, false }, false, 0);
+  // idle after 10 minutes without a tap, one tap 45 minutes in
+  set_idle_minutes(10);
+  run_policy_case("idle, tap",    (BatteryChargeState){ 70, false, false }, true, 45*60);
+  set_idle_minutes(REFRESH_IDLE_MINUTES);
+
+  printf("\nevent stream, a year of days; ring of %d events, %lu bytes\n", STREAM_EVENTS,
+         (unsigned long)(STREAM_EVENTS * sizeof(StreamEvent)));
+  printf("%-8s %8s %8s %8s %8s %9s %8s %-10s %s\n", "catalog", "sent", "chunks", "bytes_in",
+         "p_write", "heap_max", "held", "shown", "restarted");
+  run_stream_case(20);
+  run_stream_case(400);
+  run_stream_case(5000);
+
+  handle_deinit();
+  return 0;
+}
@@ -0,0 +1,317 @@
+//  file: companion_sim.js
+//  Runs the companion JS on the host and counts what a session costs.
+//
+//  src/js/event_catalog.js, src/js/settings_schema.js and
+//  src/pebble-js-app.js are loaded the way the build concatenates them,
+//  with fake Pebble and localStorage objects and a clock stopped at
+//  SIM_NOW.  The configuration page the companion opens is decoded from
+//  its data URI and its script run against a fake document, so saving it
+//  goes through the real page code.  Every AppMessage to the watch is
+//  counted, with its keys and its size as a dictionary on the watch.  A
+//  settings message bigger than the watch's settings inbox
+//  (SETTINGS_INBOX_SIZE in countdown.c) is an error.
+//
+//  The watch's end of the event stream (src/stream.h) is modelled too: a
+//  ring that takes chunks the way stream_receive() does and asks for more
+//  while it has room.
+//
+//  --check FILE compares the output with the golden copy in FILE.
+//
+//  usage: node host/companion_sim.js [--check FILE]
+
+var fs = require('fs');
+var path = require('path');
+var vm = require('vm');
+
+// 2015-05-30 00:00:00 UTC, as in the benchmark
+var SIM_NOW = 1432944000;
+
+// the phone's clock, in UTC
+function SimDate(ms) {
+  this.ms = ms;
+}
+SimDate.now = function() { return SIM_NOW * 1000; };
+SimDate.prototype.getTimezoneOffset = function() { return 0; };
+
+var messages = [];
+var handlers = {};
+var storage = {};
+var openedURL = null;
+var output = [];
+
+function log(line) {
+  line = line.replace(/\s+$/, '');
+  output.push(line);
+  console.log(line);
+}
+
+var sandbox = {
+  Pebble: {
+    addEventListener: function(name, handler) { handlers[name] = handler; },
+    sendAppMessage: function(message, success) {
+      messages.push(message);
+      if (success) success({});
+    },
+    getAccountToken: function() { return 'host'; },
+    openURL: function(url) { openedURL = url; }
+  },
+  localStorage: {
+    getItem: function(key) { return key in storage ? storage[key] : null; },
+    setItem: function(key, value) { storage[key] = String(value); }
+  },
+  Date: SimDate
+};
+
+// ---------------------------------------------------------------------------
+// the configuration page
+
+var page = null;
+
+function openConfig() {
+  openedURL = null;
+  handlers.showConfiguration({});
+  var prefix = 'data:text/html;charset=utf-8,', suffix = '<!--.html';
+  if (!openedURL || openedURL.indexOf(prefix) != 0 ||
+      openedURL.slice(-suffix.length) != suffix)
+    throw new Error('configuration is not a data URI: ' + openedURL);
+  var html = decodeURIComponent(openedURL.slice(prefix.length, -suffix.length));
+
+  var elements = {};
+  var box = /<input type="checkbox" id="(k\d+)"( checked)?>/g, m;
+  while ((m = box.exec(html)))
+    elements[m[1]] = { checked: !!m[2] };
+  var script = html.slice(html.indexOf('<script>') + 8, html.indexOf('</script>'));
+  page = {
+    elements: elements,
+    context: vm.createContext({
+      document: { getElementById: function(id) { return elements[id]; } },
+      location: { href: '' },
+      encodeURIComponent: encodeURIComponent,
+      JSON: JSON
+    }),
+    size: openedURL.length
+  };
+  vm.runInContext(script, page.context);
+}
+
+function toggle(key) {
+  page.elements['k' + key].checked = !page.elements['k' + key].checked;
+}
+
+function closeConfig(button) {
+  vm.runInContext(button + '()', page.context);
+  var href = page.context.location.href;
+  handlers.webviewclosed({ response: href.slice(href.indexOf('#') + 1) });
+}
+
+// ---------------------------------------------------------------------------
+// session
+
+// a message as a dictionary on the watch: a count byte, then each tuple's
+// key, type and length ahead of its value; PebbleKit JS sends numbers as
+// int32s
+var TUPLE_HEADER = 7;
+
+function dictSize(message) {
+  var size = 1;
+  Object.keys(message).forEach(function(key) {
+    var value = message[key];
+    size += TUPLE_HEADER + (typeof value == 'number' ? 4 :
+                            typeof value == 'string' ? value.length + 1 : value.length);
+  });
+  return size;
+}
+
+// SETTINGS_INBOX_SIZE: every per-key setting and the packed ones
+var SETTINGS_PACKED_KEY = 100;
+
+function settingsInboxSize() {
+  var count = sandbox.eventSettings.length;
+  return 1 + count * (TUPLE_HEADER + 4) + TUPLE_HEADER + 1 + Math.ceil(count / 8);
+}
+
+function isSettings(message) {
+  return Object.keys(message).every(function(key) {
+    return key == SETTINGS_PACKED_KEY ||
+           sandbox.eventSettings.some(function(setting) { return setting.key == key; });
+  });
+}
+
+function step(name, action) {
+  var sent = messages.length;
+  action();
+  var keys = 0, bytes = 0;
+  for (var i = sent; i < messages.length; ++i) {
+    var size = dictSize(messages[i]);
+    if (isSettings(messages[i]) && size > settingsInboxSize())
+      throw new Error(name + ': settings message of ' + size + ' bytes, the watch takes ' +
+                      settingsInboxSize());
+    keys += Object.keys(messages[i]).length;
+    bytes += size;
+  }
+  log(pad(name, 32) + ' ' + pad(messages.length - sent, 8) + ' ' + pad(keys, 8) + ' ' +
+      pad(bytes, 8));
+}
+
+function pad(value, width) {
+  value = String(value);
+  while (value.length < width) value += ' ';
+  return value;
+}
+
+// an Array of the companion's own realm, so instanceof works
+function companionArray(bytes) {
+  return vm.runInContext(JSON.stringify(bytes), sandbox);
+}
+
+function watchAsks(packed) {
+  var payload = { action: 1 };
+  if (packed) payload[100] = companionArray(packed);
+  handlers.appmessage({ payload: payload });
+}
+
+// ---------------------------------------------------------------------------
+// the watch's event ring
+
+var STREAM_EVENTS = 16, STREAM_CHUNK = 4, STREAM_EVENT_BYTES = 30;
+var ring = { version: 0, first: 0, count: 0, last: false };
+
+function uint(bytes, offset, size) {
+  var value = 0;
+  for (var i = size - 1; i >= 0; --i)
+    value = value * 256 + bytes[offset + i];
+  return value;
+}
+
+function cursor() {
+  var bytes = [], next = ring.count ? ring.first + ring.count : 0xFFFF;
+  for (var i = 0; i < 4; ++i) bytes.push(Math.floor(ring.version / Math.pow(256, i)) & 0xFF);
+  bytes.push(next & 0xFF, next >> 8, STREAM_EVENTS - ring.count);
+  return bytes;
+}
+
+// true if the chunk changed the ring
+function receive(chunk) {
+  var version = uint(chunk, 0, 4), first = uint(chunk, 4, 2), count = chunk[6], flags = chunk[7];
+  if (chunk.length != 8 + count * STREAM_EVENT_BYTES)
+    throw new Error('chunk of ' + chunk.length + ' bytes for ' + count + ' events');
+  if (flags & 2) {
+    if (ring.count && version == ring.version && first == ring.first) return false;
+    ring = { version: version, first: first, count: 0, last: false };
+  } else if (!ring.count || version != ring.version || first != ring.first + ring.count) {
+    return false;
+  }
+  var added = Math.min(count, STREAM_EVENTS - ring.count);
+  ring.count += added;
+  ring.last = added == count && (flags & 1) != 0;
+  return true;
+}
+
+// the watch sends action (1 settings, 2 events) with its cursor and takes
+// any chunks that come back, asking for the next one while it has room
+function watchStreams(action) {
+  for (;;) {
+    var sent = messages.length;
+    handlers.appmessage({ payload: { action: action, 102: companionArray(cursor()) } });
+    var more = false;
+    for (var i = sent; i < messages.length; ++i) {
+      if (messages[i][103] && receive(messages[i][103]))
+        more = !ring.last && STREAM_EVENTS - ring.count >= STREAM_CHUNK;
+    }
+    if (!more) return;
+    action = 2;
+  }
+}
+
+// events that are over leave the ring, the last one stays
+function watchDrops(over) {
+  over = Math.min(over, ring.count - 1);
+  ring.first += over;
+  ring.count -= over;
+}
+
+var sources = ['js/event_catalog.js', 'js/settings_schema.js', 'pebble-js-app.js'].map(function(name) {
+  return fs.readFileSync(path.join(__dirname, '..', 'src', name), 'utf8');
+});
+vm.createContext(sandbox);
+vm.runInContext(sources.join('\n'), sandbox);
+handlers.ready({});
+
+log(pad('step', 32) + ' ' + pad('msgs', 8) + ' ' + pad('keys', 8) + ' ' + pad('bytes', 8));
+step('first launch', function() { watchAsks(); });
+step('relaunch, nothing changed', function() { watchAsks(); });
+step('open config', openConfig);
+step('save with one toggle changed', function() {
+  toggle(3);
+  closeConfig('save');
+});
+step('open config, save unchanged', function() {
+  openConfig();
+  closeConfig('save');
+});
+step('open config, cancel', function() {
+  openConfig();
+  toggle(4);
+  closeConfig('cancel');
+});
+step('save with three toggles changed', function() {
+  openConfig();
+  toggle(3);
+  toggle(5);
+  toggle(9);
+  closeConfig('save');
+});
+step('watch lost its settings', function() { watchAsks([1, 255, 3]); });
+step('old full-page response', function() {
+  handlers.webviewclosed({ response: encodeURIComponent(JSON.stringify(
+    { '1': 1, '2': 1, '3': 1, '4': 1, '5': 0, '6': 1, '7': 1, '8': 1, '9': 1, '10': 1 })) });
+});
+
+step('events, first window', function() { watchStreams(1); });
+step('events, relaunch', function() { watchStreams(1); });
+step('events, setting turned off', function() {
+  openConfig();
+  toggle(6);
+  closeConfig('save');
+  // the watch asks with the cursor it has, from the old settings
+  watchStreams(2);
+});
+
+// a catalog of a few hundred events, one a week
+var events = [];
+for (var week = 0; week < 400; ++week)
+  events.push([SIM_NOW / (24 * 60 * 60) + week * 7, 11 + week % 200, 2, 'EVENT' + week]);
+// 9999-12-30, as in events.json
+events.push([2932895, 255, 0, 'MINI']);
+sandbox.eventCatalog = { version: 1, events: events };
+step('events, 400 event catalog', function() { watchStreams(1); });
+step('events, 4 over, top up', function() {
+  watchDrops(4);
+  watchStreams(2);
+});
+step('events, 3 over, settings asked', function() {
+  watchDrops(3);
+  watchStreams(1);
+});
+
+log('');
+log('config page: ' + page.size + ' bytes as a data URI; ' + messages.length + ' app messages');
+log('settings inbox: ' + settingsInboxSize() + ' bytes');
+log('event ring: ' + ring.count + ' of ' + STREAM_EVENTS + ' held, sequence ' + ring.first + ' on');
+
+var check = process.argv.indexOf('--check');
+if (check >= 0) {
+  var goldenPath = process.argv[check + 1];
+  var golden = fs.readFileSync(goldenPath, 'utf8').split('\n');
+  var failed = false;
+  output.push('');
+  for (var n = 0; n < Math.max(output.length, golden.length); ++n) {
+    if (output[n] === golden[n]) continue;
+    failed = true;
+    console.error('line %d differs from %s\n  got:    %s\n  wanted: %s', n + 1, goldenPath,
+                  n < output.length ? output[n] : '(end of file)',
+                  n < golden.length ? golden[n] : '(end of file)');
+  }
+  if (failed) process.exit(1);
+  console.log('companion matches %s', goldenPath);
+}
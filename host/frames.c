@@ -0,0 +1,235 @@
+//  file: frames.c
+//  Golden frames of countdown.c, drawn on the host
+//
+//  Like replay.c, countdown.c is compiled straight into this file.  The
+//  stub draws into its 1-bit frame buffer (see stub_draw_enabled) and we
+//  step the face through the moments below, writing each frame as a PNG
+//  along with what it cost:
+//    dirty_px    the area the face marked dirty before the frame
+//    layers      layers whose update proc ran
+//    changed_px  frame buffer pixels that actually changed, and their
+//                bounding box
+//  Text is drawn in the stub's own font, so the frames show layout and
+//  redraw, not the real typefaces.  Aplite only.
+//
+//  Two kinds of file come out: frames.txt with a row per frame, and
+//  NN-name.png per frame.  --check DIR compares frames.txt line by line
+//  and each PNG pixel by pixel with the golden copies in DIR.
+//
+//  usage: countdown-frames [--out DIR] [--check DIR]
+
+#define main countdown_main
+#include "../src/countdown.c"
+#undef main
+#undef snprintf
+#undef strftime
+
+#include "png.h"
+
+typedef enum {
+  step_start,
+  step_tick,
+  step_battery,
+  step_bluetooth,
+} StepKind;
+
+typedef struct {
+  const char *name;
+  StepKind    kind;
+  // watch time, UTC; the watch is on UTC too
+  int         year, month, day, hour, minute, second;
+  // charge percent or connected
+  int         arg;
+} Frame;
+
+// two seconds before the day count for AMVIV drops to 1
+static const Frame frames[] = {
+  { "first",         step_start,     2015, 5, 26, 23, 59, 58, 0  },
+  { "indicators",    step_tick,      2015, 5, 26, 23, 59, 58, 0  },
+  { "second",        step_tick,      2015, 5, 26, 23, 59, 59, 0  },
+  { "midnight",      step_tick,      2015, 5, 27,  0,  0,  0, 0  },
+  { "minute",        step_tick,      2015, 5, 27,  0,  1,  0, 0  },
+  { "hour",          step_tick,      2015, 5, 27,  1,  0,  0, 0  },
+  { "battery-low",   step_battery,   2015, 5, 27,  1,  0,  1, 15 },
+  { "bluetooth-off", step_bluetooth, 2015, 5, 27,  1,  0,  2, 0  },
+  { "event-on",      step_tick,      2015, 5, 28,  0,  0,  0, 0  },
+};
+
+static FILE *table;
+static struct tm last_tm;
+
+static TimeUnits units_between(const struct tm *a, const struct tm *b)
+{
+  TimeUnits units = 0;
+  if (a->tm_sec != b->tm_sec) units |= SECOND_UNIT;
+  if (a->tm_min != b->tm_min) units |= MINUTE_UNIT;
+  if (a->tm_hour != b->tm_hour) units |= HOUR_UNIT;
+  if (a->tm_mday != b->tm_mday || a->tm_mon != b->tm_mon || a->tm_year != b->tm_year) units |= DAY_UNIT;
+  if (a->tm_mon != b->tm_mon || a->tm_year != b->tm_year) units |= MONTH_UNIT;
+  if (a->tm_year != b->tm_year) units |= YEAR_UNIT;
+  return units;
+}
+
+static void run_frame(const Frame *frame, unsigned int n, const char *out_dir)
+{
+  struct tm tm = { 0 };
+  tm.tm_year = frame->year - 1900;
+  tm.tm_mon  = frame->month - 1;
+  tm.tm_mday = frame->day;
+  tm.tm_hour = frame->hour;
+  tm.tm_min  = frame->minute;
+  tm.tm_sec  = frame->second;
+  time_t watch = timegm(&tm);
+  gmtime_r(&watch, &tm);
+  stub_set_time(watch);
+
+  switch (frame->kind) {
+  case step_start:
+    stub_persist_clear();
+    handle_init();
+    break;
+  case step_tick:
+    stub_run_timers();
+    // a jump of more than a tick still only delivers one
+    stub_tick(&tm, units_between(&last_tm, &tm) | SECOND_UNIT);
+    break;
+  case step_battery:
+    stub_battery_event((BatteryChargeState){ frame->arg, false, false });
+    break;
+  case step_bluetooth:
+    stub_bluetooth_event(frame->arg);
+    break;
+  }
+  last_tm = tm;
+
+  uint32_t dirty_px = face_dirty.size.w * face_dirty.size.h;
+  stub_render();
+
+  char name[64], path[256];
+  snprintf(name, sizeof(name), "%02u-%s.png", n, frame->name);
+  snprintf(path, sizeof(path), "%s/%s", out_dir, name);
+  const GBitmap *fb = stub_frame_buffer();
+  if (!png_write_1bit(path, fb->bounds.size.w, fb->bounds.size.h, fb->addr, fb->row_size_bytes)) {
+    perror(path);
+    exit(2);
+  }
+
+  char when[32];
+  strftime(when, sizeof(when), "%Y-%m-%d %H:%M:%S", &tm);
+  const GRect *box = &stub_damage.box;
+  fprintf(table, "%-20s %s %8lu %6lu %10lu  %3d,%3d %3dx%3d\n", name, when, (unsigned long)dirty_px,
+          (unsigned long)stub_damage.layers, (unsigned long)stub_damage.pixels,
+          box->origin.x, box->origin.y, box->size.w, box->size.h);
+}
+
+// ---------------------------------------------------------------------------
+// checking
+
+static int compare_table(const char *out_dir, const char *golden_dir)
+{
+  char path[256], golden_path[256];
+  snprintf(path, sizeof(path), "%s/frames.txt", out_dir);
+  snprintf(golden_path, sizeof(golden_path), "%s/frames.txt", golden_dir);
+  FILE *f = fopen(path, "r");
+  FILE *g = fopen(golden_path, "r");
+  if (!f || !g) {
+    fprintf(stderr, "cannot compare %s with %s\n", path, golden_path);
+    if (f) fclose(f);
+    if (g) fclose(g);
+    return 1;
+  }
+
+  char line[256], golden_line[256];
+  int n = 0, failed = 0;
+  while (!failed) {
+    ++n;
+    char *a = fgets(line, sizeof(line), f);
+    char *b = fgets(golden_line, sizeof(golden_line), g);
+    if (!a && !b) break;
+    if (!a || !b || strcmp(a, b) != 0) {
+      failed = 1;
+      fprintf(stderr, "%s:%d differs from %s\n  got:    %s  wanted: %s", path, n, golden_path,
+              a ? a : "(end of file)\n", b ? b : "(end of file)\n");
+    }
+  }
+  fclose(f);
+  fclose(g);
+  return failed;
+}
+
+static int compare_frame(const char *out_dir, const char *golden_dir, const char *name)
+{
+  char path[256], golden_path[256];
+  snprintf(path, sizeof(path), "%s/%s", out_dir, name);
+  snprintf(golden_path, sizeof(golden_path), "%s/%s", golden_dir, name);
+  PngImage got, wanted;
+  if (!png_load(path, &got)) {
+    fprintf(stderr, "cannot read %s\n", path);
+    return 1;
+  }
+  if (!png_load(golden_path, &wanted)) {
+    fprintf(stderr, "cannot read %s\n", golden_path);
+    png_free(&got);
+    return 1;
+  }
+
+  int failed = 0;
+  if (got.width != wanted.width || got.height != wanted.height) {
+    fprintf(stderr, "%s is %ux%u, %s is %ux%u\n", path, got.width, got.height,
+            golden_path, wanted.width, wanted.height);
+    failed = 1;
+  } else {
+    unsigned long differ = 0;
+    for (size_t i = 0; i < (size_t)got.width * got.height; ++i) {
+      if (got.grey[i] != wanted.grey[i]) ++differ;
+    }
+    if (differ) {
+      fprintf(stderr, "%s: %lu pixels differ from %s\n", path, differ, golden_path);
+      failed = 1;
+    }
+  }
+  png_free(&got);
+  png_free(&wanted);
+  return failed;
+}
+
+int main(int argc, char **argv)
+{
+  const char *out_dir = ".";
+  const char *golden_dir = NULL;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--out") == 0)
+      out_dir = argv[i+1];
+    else if (strcmp(argv[i], "--check") == 0)
+      golden_dir = argv[i+1];
+  }
+
+  setenv("TZ", "UTC", 1);
+  tzset();
+  stub_draw_enabled = true;
+
+  char path[256];
+  snprintf(path, sizeof(path), "%s/frames.txt", out_dir);
+  table = fopen(path, "w");
+  if (!table) {
+    perror(path);
+    return 2;
+  }
+  fprintf(table, "%-20s %-19s %8s %6s %10s  %s\n", "frame", "watch time", "dirty_px", "layers",
+          "changed_px", "changed box");
+  for (unsigned int i = 0; i < ARRAY_LENGTH(frames); ++i) {
+    run_frame(&frames[i], i, out_dir);
+  }
+  fclose(table);
+  handle_deinit();
+
+  if (!golden_dir) return 0;
+  int failed = compare_table(out_dir, golden_dir);
+  for (unsigned int i = 0; i < ARRAY_LENGTH(frames); ++i) {
+    char name[64];
+    snprintf(name, sizeof(name), "%02u-%s.png", i, frames[i].name);
+    failed |= compare_frame(out_dir, golden_dir, name);
+  }
+  if (!failed) printf("frames match %s\n", golden_dir);
+  return failed;
+}
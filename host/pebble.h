@@ -0,0 +1,518 @@
+//  file: pebble.h
+//  Host-side stand-in for the subset of the Pebble SDK used by src/*.c
+//
+//  This is NOT the SDK.  It only declares enough of the API for
+//  countdown.c to compile on a Linux host, and records how often the
+//  watchface calls into the parts we care about for the tick path
+//  (redraws, persistent storage and localtime).
+//  See pebble_stub.c for the implementation and bench_tick.c for the
+//  benchmark that uses it.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+// ---------------------------------------------------------------------------
+// platform
+//
+// The SDK defines these per target platform.  The stub is aplite unless
+// built with -DPBL_PLATFORM_BASALT or -DPBL_PLATFORM_CHALK, which is
+// enough to compile-check the colour and round code paths.
+
+#define PBL_SDK_3
+#if defined(PBL_PLATFORM_CHALK)
+#define PBL_COLOR
+#define PBL_ROUND
+#elif defined(PBL_PLATFORM_BASALT)
+#define PBL_COLOR
+#define PBL_RECT
+#else
+#define PBL_PLATFORM_APLITE
+#define PBL_BW
+#define PBL_RECT
+#endif
+
+// ---------------------------------------------------------------------------
+// call recording
+
+typedef struct {
+  uint32_t layer_mark_dirty;
+  uint32_t frames;
+  uint32_t draw_text;
+  uint32_t draw_bitmap;
+  uint32_t persist_exists;
+  uint32_t persist_reads;
+  uint32_t persist_writes;
+  uint32_t resource_loads;
+  uint32_t localtime;
+  uint32_t time;
+  // tick handler calls and timer callbacks, i.e. wakeups
+  uint32_t ticks;
+  uint32_t timers_fired;
+  // strftime and snprintf calls
+  uint32_t formats;
+  // AppMessages the app handed to the outbox
+  uint32_t app_messages;
+} StubCounters;
+
+extern StubCounters stub_counters;
+
+void stub_reset_counters(void);
+
+// the watch clock; time(NULL) returns this instead of the host clock
+void stub_set_time(time_t now);
+time_t stub_get_time(void);
+
+// settings the watch would normally own
+extern bool stub_clock_24h;
+extern bool stub_log_enabled;
+
+// ---------------------------------------------------------------------------
+// logging and helpers
+
+typedef enum {
+  APP_LOG_LEVEL_ERROR = 1,
+  APP_LOG_LEVEL_WARNING = 50,
+  APP_LOG_LEVEL_INFO = 100,
+  APP_LOG_LEVEL_DEBUG = 200,
+  APP_LOG_LEVEL_DEBUG_VERBOSE = 255,
+} AppLogLevel;
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...);
+
+#define APP_LOG(level, fmt, args...) \
+  app_log(level, __FILE__, __LINE__, fmt, ## args)
+
+#define ARRAY_LENGTH(array) (sizeof((array))/sizeof((array)[0]))
+
+// time(NULL) and localtime() go through the stub so they can be counted
+// and so the benchmark controls the clock
+time_t stub_time(time_t *tloc);
+struct tm *stub_localtime(const time_t *timep);
+#define time(tloc)       stub_time(tloc)
+#define localtime(timep) stub_localtime(timep)
+// the watch clock plus milliseconds from the uptime clock, not counted
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms);
+
+// count string formatting too
+#define strftime(...) (++stub_counters.formats, strftime(__VA_ARGS__))
+#define snprintf(...) (++stub_counters.formats, snprintf(__VA_ARGS__))
+
+bool clock_is_24h_style(void);
+
+// ---------------------------------------------------------------------------
+// graphics types
+
+typedef struct GPoint {
+  int16_t x;
+  int16_t y;
+} GPoint;
+
+typedef struct GSize {
+  int16_t w;
+  int16_t h;
+} GSize;
+
+typedef struct GRect {
+  GPoint origin;
+  GSize size;
+} GRect;
+
+#define GRect(x, y, w, h) ((GRect){{(x), (y)}, {(w), (h)}})
+
+#define GSize(w, h) ((GSize){(w), (h)})
+
+// SDK3 bitmaps are opaque, see the accessors below; the stub adds its
+// own fields
+typedef struct GBitmap {
+  void    *addr;
+  uint16_t row_size_bytes;
+  uint16_t info_flags;
+  GRect    bounds;
+  uint32_t resource_id;
+  // bytes this bitmap would take from the app heap on the watch
+  size_t   heap;
+} GBitmap;
+
+typedef enum {
+  GCornerNone = 0,
+} GCornerMask;
+
+typedef enum GColor {
+  GColorClear = ~0,
+  GColorBlack = 0,
+  GColorWhite = 1,
+} GColor;
+
+typedef enum {
+  GTextOverflowModeWordWrap,
+  GTextOverflowModeTrailingEllipsis,
+  GTextOverflowModeFill,
+} GTextOverflowMode;
+
+typedef void *GTextLayoutCacheRef;
+
+typedef enum {
+  GTextAlignmentLeft,
+  GTextAlignmentCenter,
+  GTextAlignmentRight,
+} GTextAlignment;
+
+typedef enum {
+  GCompOpAssign,
+  GCompOpAssignInverted,
+  GCompOpOr,
+  GCompOpAnd,
+  GCompOpClear,
+  GCompOpSet,
+} GCompOp;
+
+typedef struct Layer Layer;
+typedef struct Window Window;
+typedef struct GContext GContext;
+typedef const char *GFont;
+
+// ---------------------------------------------------------------------------
+// resources (ids match the order in appinfo.json)
+
+enum {
+  RESOURCE_ID_INDICATOR_ATLAS = 1,
+  RESOURCE_ID_IMAGE_BACKGROUND,
+  RESOURCE_ID_EVENT_CATALOG,
+};
+
+typedef const void *ResHandle;
+
+// raw resources are read from files under this directory
+extern const char *stub_resource_dir;
+
+ResHandle resource_get_handle(uint32_t resource_id);
+size_t resource_size(ResHandle h);
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes);
+
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id);
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect);
+GBitmap *gbitmap_create_blank(GSize size);
+void gbitmap_destroy(GBitmap *bitmap);
+uint8_t *gbitmap_get_data(const GBitmap *bitmap);
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap);
+
+// the stub charges bitmaps what they would cost on the watch
+size_t heap_bytes_free(void);
+size_t heap_bytes_used(void);
+
+#define FONT_KEY_GOTHIC_14                 "RESOURCE_ID_GOTHIC_14"
+#define FONT_KEY_GOTHIC_24_BOLD            "RESOURCE_ID_GOTHIC_24_BOLD"
+#define FONT_KEY_GOTHIC_28_BOLD            "RESOURCE_ID_GOTHIC_28_BOLD"
+#define FONT_KEY_BITHAM_30_BLACK           "RESOURCE_ID_BITHAM_30_BLACK"
+#define FONT_KEY_BITHAM_34_MEDIUM_NUMBERS  "RESOURCE_ID_BITHAM_34_MEDIUM_NUMBERS"
+
+GFont fonts_get_system_font(const char *font_key);
+
+// ---------------------------------------------------------------------------
+// windows and layers
+
+typedef void (*WindowHandler)(Window *window);
+
+typedef struct {
+  WindowHandler load;
+  WindowHandler appear;
+  WindowHandler disappear;
+  WindowHandler unload;
+} WindowHandlers;
+
+Window *window_create(void);
+void window_destroy(Window *window);
+Layer *window_get_root_layer(const Window *window);
+void window_set_background_color(Window *window, GColor background_color);
+void window_set_window_handlers(Window *window, WindowHandlers handlers);
+// calls the appear handler
+void window_stack_push(Window *window, bool animated);
+
+typedef void (*LayerUpdateProc)(Layer *layer, GContext *ctx);
+
+Layer *layer_create(GRect frame);
+void layer_destroy(Layer *layer);
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc);
+void layer_mark_dirty(Layer *layer);
+GRect layer_get_bounds(const Layer *layer);
+void layer_add_child(Layer *parent, Layer *child);
+void layer_set_hidden(Layer *layer, bool hidden);
+bool layer_get_hidden(const Layer *layer);
+
+// runs the update proc of every dirty, visible layer, as the next frame
+// would on the watch
+void stub_render(void);
+
+// false: graphics calls only count, which is all the benchmark and the
+// replay need; true: they also draw into the 144x168 1-bit frame buffer
+extern bool stub_draw_enabled;
+
+// what the last stub_render() did: layers whose update proc ran and,
+// while drawing, the frame buffer pixels that changed and their bounds
+typedef struct {
+  uint32_t layers;
+  uint32_t pixels;
+  GRect    box;
+} StubDamage;
+
+extern StubDamage stub_damage;
+
+const GBitmap *stub_frame_buffer(void);
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode);
+void graphics_context_set_text_color(GContext *ctx, GColor color);
+void graphics_context_set_fill_color(GContext *ctx, GColor color);
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask);
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect);
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment,
+                        GTextLayoutCacheRef layout);
+// in the stub's scaled 5x7 font, see pebble_stub.c
+GSize graphics_text_layout_get_content_size(const char *text, GFont font, GRect box,
+                                            GTextOverflowMode overflow_mode, GTextAlignment alignment);
+
+// the 144x168 1-bit buffer, drawn into only with stub_draw_enabled
+GBitmap *graphics_capture_frame_buffer(GContext *ctx);
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer);
+
+// ---------------------------------------------------------------------------
+// event services
+
+typedef enum {
+  SECOND_UNIT = 1 << 0,
+  MINUTE_UNIT = 1 << 1,
+  HOUR_UNIT   = 1 << 2,
+  DAY_UNIT    = 1 << 3,
+  MONTH_UNIT  = 1 << 4,
+  YEAR_UNIT   = 1 << 5,
+} TimeUnits;
+
+typedef void (*TickHandler)(struct tm *tick_time, TimeUnits units_changed);
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler);
+void tick_timer_service_unsubscribe(void);
+
+typedef struct {
+  uint8_t charge_percent;
+  bool is_charging;
+  bool is_plugged;
+} BatteryChargeState;
+
+typedef void (*BatteryStateHandler)(BatteryChargeState charge);
+
+void battery_state_service_subscribe(BatteryStateHandler handler);
+void battery_state_service_unsubscribe(void);
+BatteryChargeState battery_state_service_peek(void);
+
+typedef void (*BluetoothConnectionHandler)(bool connected);
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler);
+void bluetooth_connection_service_unsubscribe(void);
+bool bluetooth_connection_service_peek(void);
+
+extern BatteryChargeState stub_battery_state;
+extern bool stub_bluetooth_connected;
+
+typedef enum {
+  ACCEL_AXIS_X = 0,
+  ACCEL_AXIS_Y = 1,
+  ACCEL_AXIS_Z = 2,
+} AccelAxisType;
+
+typedef void (*AccelTapHandler)(AccelAxisType axis, int32_t direction);
+
+void accel_tap_service_subscribe(AccelTapHandler handler);
+void accel_tap_service_unsubscribe(void);
+
+// the subscribed unit, and delivery of service events as if they came
+// from the system
+extern TimeUnits stub_tick_units;
+void stub_tick(struct tm *tick_time, TimeUnits units_changed);
+void stub_battery_event(BatteryChargeState charge);
+void stub_bluetooth_event(bool connected);
+void stub_tap_event(void);
+
+// ---------------------------------------------------------------------------
+// timers, driven by the stub clock
+
+typedef struct AppTimer AppTimer;
+typedef void (*AppTimerCallback)(void *data);
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data);
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms);
+void app_timer_cancel(AppTimer *timer_handle);
+
+// Timers count on an uptime clock like the watch's, so they are not
+// moved by the wall clock changing.  Unless it is set it follows the
+// stub clock.
+void stub_set_uptime_ms(uint64_t uptime_ms);
+// fire every timer due at or before the uptime clock
+void stub_run_timers(void);
+// when the next timer is due, false if there is none
+bool stub_next_timer_ms(uint64_t *due_ms);
+
+// ---------------------------------------------------------------------------
+// persistent storage (kept in host memory)
+
+#define PERSIST_DATA_MAX_LENGTH 256
+
+bool persist_exists(const uint32_t key);
+bool persist_read_bool(const uint32_t key);
+int32_t persist_read_int(const uint32_t key);
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size);
+int persist_write_bool(const uint32_t key, const bool value);
+int persist_write_int(const uint32_t key, const int32_t value);
+int persist_write_data(const uint32_t key, const void *data, const size_t size);
+int persist_delete(const uint32_t key);
+
+void stub_persist_clear(void);
+
+// ---------------------------------------------------------------------------
+// AppMessage / AppSync
+
+typedef enum {
+  APP_MSG_OK = 0,
+  APP_MSG_SEND_TIMEOUT = 1 << 1,
+  APP_MSG_SEND_REJECTED = 1 << 2,
+  APP_MSG_NOT_CONNECTED = 1 << 3,
+  APP_MSG_APP_NOT_RUNNING = 1 << 4,
+  APP_MSG_INVALID_ARGS = 1 << 5,
+  APP_MSG_BUSY = 1 << 6,
+  APP_MSG_BUFFER_OVERFLOW = 1 << 7,
+  APP_MSG_ALREADY_RELEASED = 1 << 9,
+  APP_MSG_CALLBACK_ALREADY_REGISTERED = 1 << 10,
+  APP_MSG_CALLBACK_NOT_REGISTERED = 1 << 11,
+  APP_MSG_OUT_OF_MEMORY = 1 << 12,
+  APP_MSG_CLOSED = 1 << 13,
+  APP_MSG_INTERNAL_ERROR = 1 << 14,
+} AppMessageResult;
+
+typedef enum {
+  DICT_OK = 0,
+  DICT_NOT_ENOUGH_STORAGE = 1 << 1,
+  DICT_INVALID_ARGS = 1 << 2,
+  DICT_INTERNAL_INCONSISTENCY = 1 << 3,
+  DICT_MALLOC_FAILED = 1 << 4,
+} DictionaryResult;
+
+typedef enum {
+  TUPLE_BYTE_ARRAY = 0,
+  TUPLE_CSTRING = 1,
+  TUPLE_UINT = 2,
+  TUPLE_INT = 3,
+} TupleType;
+
+typedef union {
+  uint8_t data[0];
+  char cstring[0];
+  uint8_t uint8;
+  uint16_t uint16;
+  uint32_t uint32;
+  int8_t int8;
+  int16_t int16;
+  int32_t int32;
+} TupleValue;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t key;
+  TupleType type:8;
+  uint16_t length;
+  TupleValue value[];
+} Tuple;
+
+typedef struct Tuplet {
+  TupleType type;
+  uint32_t key;
+  union {
+    struct {
+      const uint8_t *data;
+      const uint16_t length;
+    } bytes;
+    struct {
+      const char *data;
+      const uint16_t length;
+    } cstring;
+    struct {
+      uint32_t storage;
+      const uint16_t width;
+    } integer;
+  };
+} Tuplet;
+
+#define TupletBytes(_key, _data, _length) \
+  ((const Tuplet) { .type = TUPLE_BYTE_ARRAY, .key = _key, \
+                    .bytes = { .data = _data, .length = _length }})
+
+#define TupletInteger(_key, _integer) \
+  ((const Tuplet) { .type = TUPLE_UINT, .key = _key, \
+                    .integer = { .storage = _integer, .width = sizeof(_integer) }})
+
+typedef void (*AppSyncTupleChangedCallback)(const uint32_t key, const Tuple *new_tuple,
+                                            const Tuple *old_tuple, void *context);
+typedef void (*AppSyncErrorCallback)(DictionaryResult dict_error,
+                                     AppMessageResult app_message_error, void *context);
+
+typedef struct AppSync {
+  AppSyncTupleChangedCallback tuple_changed;
+  AppSyncErrorCallback error;
+  void *context;
+  uint8_t *buffer;
+  uint16_t buffer_size;
+} AppSync;
+
+typedef struct DictionaryIterator {
+  uint8_t *cursor;
+  uint8_t *end;
+  uint8_t  count;
+} DictionaryIterator;
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value);
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data,
+                                 const uint16_t size);
+
+typedef void (*AppMessageOutboxSent)(DictionaryIterator *iterator, void *context);
+typedef void (*AppMessageOutboxFailed)(DictionaryIterator *iterator, AppMessageResult reason, void *context);
+
+uint32_t app_message_inbox_size_maximum(void);
+uint32_t app_message_outbox_size_maximum(void);
+// the buffers come out of the app heap, as on the watch
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound);
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback);
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback);
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator);
+AppMessageResult app_message_outbox_send(void);
+
+// The phone's side of the outbox.  A sent message stays pending until
+// stub_app_message_complete() acks it (APP_MSG_OK) or fails it with that
+// reason; until then app_message_outbox_begin() says APP_MSG_BUSY.
+bool stub_app_message_pending(void);
+// bytes written into the pending message
+size_t stub_app_message_size(void);
+// a tuple of the pending message, NULL if it has none with that key
+const Tuple *stub_app_message_find(uint32_t key);
+void stub_app_message_complete(AppMessageResult result);
+// drop the buffers and callbacks, as the watch does when the app exits
+void stub_app_message_close(void);
+
+void app_sync_init(AppSync *s, uint8_t *buffer, const uint16_t buffer_size,
+                   const Tuplet * const keys_and_initial_values, const uint8_t count,
+                   AppSyncTupleChangedCallback tuple_changed_callback,
+                   AppSyncErrorCallback error_callback, void *context);
+void app_sync_deinit(AppSync *s);
+
+// deliver an incoming tuple to the AppSync registered by the app, as if
+// the phone had sent it; PebbleKit JS sends every number as an int32
+void stub_app_sync_receive(uint32_t key, int32_t value);
+void stub_app_sync_receive_bytes(uint32_t key, const uint8_t *data, uint16_t length);
+
+// ---------------------------------------------------------------------------
+// the stub's event loop returns immediately; the benchmark drives handlers
+
+void app_event_loop(void);
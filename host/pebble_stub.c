@@ -0,0 +1,1177 @@
+//  file: pebble_stub.c
+//  Host-side implementation of the SDK subset declared in pebble.h
+//
+//  Layers and bitmaps are plain heap objects.  stub_render() runs the
+//  update procs of dirty layers; the graphics calls only count unless
+//  stub_draw_enabled is set, see "drawing" below.  Calls on the tick path are counted in
+//  stub_counters so the benchmark can report calls-per-tick.
+
+#include <stdarg.h>
+#include "pebble.h"
+#include "png.h"
+
+StubCounters stub_counters;
+
+bool stub_clock_24h = false;
+bool stub_log_enabled = false;
+
+BatteryChargeState stub_battery_state = { 70, false, false };
+bool stub_bluetooth_connected = true;
+
+static time_t stub_now = 0;
+static struct tm stub_tm;
+
+void stub_reset_counters(void)
+{
+  memset(&stub_counters, 0, sizeof(stub_counters));
+}
+
+void stub_set_time(time_t now)
+{
+  stub_now = now;
+}
+
+time_t stub_get_time(void)
+{
+  return stub_now;
+}
+
+time_t stub_time(time_t *tloc)
+{
+  ++stub_counters.time;
+  if (tloc) *tloc = stub_now;
+  return stub_now;
+}
+
+struct tm *stub_localtime(const time_t *timep)
+{
+  ++stub_counters.localtime;
+  return localtime_r(timep, &stub_tm);
+}
+
+bool clock_is_24h_style(void)
+{
+  return stub_clock_24h;
+}
+
+void app_log(uint8_t log_level, const char *src_filename, int src_line_number, const char *fmt, ...)
+{
+  if (!stub_log_enabled) return;
+  va_list args;
+  va_start(args, fmt);
+  fprintf(stderr, "[%u] %s:%d ", log_level, src_filename, src_line_number);
+  vfprintf(stderr, fmt, args);
+  fputc('\n', stderr);
+  va_end(args);
+}
+
+// ---------------------------------------------------------------------------
+// graphics
+
+struct Layer {
+  GRect           frame;
+  bool            hidden;
+  bool            dirty;
+  LayerUpdateProc update_proc;
+};
+
+struct Window {
+  Layer          root;
+  WindowHandlers handlers;
+};
+
+struct GContext {
+  GCompOp compositing_mode;
+  GColor  text_color;
+  GColor  fill_color;
+  // of the layer being drawn, in screen coordinates
+  GPoint  offset;
+  GRect   clip;
+};
+
+// ---------------------------------------------------------------------------
+// resources
+
+const char *stub_resource_dir = "resources";
+
+typedef struct {
+  uint32_t    id;
+  const char *file;
+  uint8_t    *data;
+  size_t      size;
+} StubResource;
+
+static StubResource stub_resources[] = {
+#if defined(PBL_BW)
+  { RESOURCE_ID_INDICATOR_ATLAS,  "images/indicators.png", NULL, 0 },
+#else
+  { RESOURCE_ID_INDICATOR_ATLAS,  "images/indicators-color.png", NULL, 0 },
+#endif
+  { RESOURCE_ID_IMAGE_BACKGROUND, "images/background.png", NULL, 0 },
+  { RESOURCE_ID_EVENT_CATALOG,    "data/events.bin",       NULL, 0 },
+};
+
+ResHandle resource_get_handle(uint32_t resource_id)
+{
+  for (unsigned int i = 0; i < ARRAY_LENGTH(stub_resources); ++i) {
+    StubResource *r = &stub_resources[i];
+    if (r->id != resource_id) continue;
+    if (!r->data) {
+      char path[256];
+      snprintf(path, sizeof(path), "%s/%s", stub_resource_dir, r->file);
+      FILE *f = fopen(path, "rb");
+      if (!f) {
+        fprintf(stderr, "stub: cannot open resource %s\n", path);
+        return NULL;
+      }
+      fseek(f, 0, SEEK_END);
+      r->size = ftell(f);
+      fseek(f, 0, SEEK_SET);
+      r->data = malloc(r->size);
+      r->size = fread(r->data, 1, r->size, f);
+      fclose(f);
+    }
+    return r;
+  }
+  return NULL;
+}
+
+size_t resource_size(ResHandle h)
+{
+  return h ? ((const StubResource *)h)->size : 0;
+}
+
+size_t resource_load_byte_range(ResHandle h, uint32_t start_offset, uint8_t *buffer, size_t num_bytes)
+{
+  ++stub_counters.resource_loads;
+  const StubResource *r = h;
+  if (!r || start_offset >= r->size) return 0;
+  if (num_bytes > r->size - start_offset) num_bytes = r->size - start_offset;
+  memcpy(buffer, r->data + start_offset, num_bytes);
+  return num_bytes;
+}
+
+// ---------------------------------------------------------------------------
+// heap
+
+// what an app gets, less the app itself
+#if defined(PBL_BW)
+#define STUB_HEAP_SIZE    (24 * 1024)
+#else
+#define STUB_HEAP_SIZE    (64 * 1024)
+#endif
+// sizeof(GBitmap) on the watch
+#define STUB_BITMAP_HEADER 16
+
+static size_t stub_heap_used;
+
+size_t heap_bytes_free(void)
+{
+  return STUB_HEAP_SIZE - stub_heap_used;
+}
+
+size_t heap_bytes_used(void)
+{
+  return stub_heap_used;
+}
+
+// png resources become 1-bit bitmaps with rows padded to 32 bits on
+// aplite, 8-bit ones elsewhere; the heap size comes from the PNG header.
+// The stub itself always keeps them 1-bit, for drawing.
+GBitmap *gbitmap_create_with_resource(uint32_t resource_id)
+{
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->resource_id = resource_id;
+  const StubResource *r = resource_get_handle(resource_id);
+  if (r && r->size >= 24) {
+    const uint8_t *ihdr = r->data + 16;
+    int16_t w = (ihdr[0] << 24 | ihdr[1] << 16 | ihdr[2] << 8 | ihdr[3]);
+    int16_t h = (ihdr[4] << 24 | ihdr[5] << 16 | ihdr[6] << 8 | ihdr[7]);
+    bitmap->bounds = GRect(0, 0, w, h);
+#if defined(PBL_BW)
+    bitmap->heap = (w + 31) / 32 * 4 * h;
+#else
+    bitmap->heap = w * h;
+#endif
+    ++stub_counters.resource_loads;
+
+    PngImage image;
+    if (png_decode(r->data, r->size, &image)) {
+      bitmap->row_size_bytes = (image.width + 31) / 32 * 4;
+      bitmap->addr = calloc(image.height, bitmap->row_size_bytes);
+      bitmap->info_flags = 1;
+      uint8_t *pixels = bitmap->addr;
+      for (uint16_t y = 0; y < image.height; ++y) {
+        for (uint16_t x = 0; x < image.width; ++x) {
+          if (image.grey[y * image.width + x] >= 0x80)
+            pixels[y * bitmap->row_size_bytes + (x >> 3)] |= 1 << (x & 7);
+        }
+      }
+      png_free(&image);
+    }
+  }
+  bitmap->heap += STUB_BITMAP_HEADER;
+  stub_heap_used += bitmap->heap;
+  return bitmap;
+}
+
+// shares the parent's pixels, so only the header is new
+GBitmap *gbitmap_create_as_sub_bitmap(const GBitmap *base_bitmap, GRect sub_rect)
+{
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->addr = base_bitmap->addr;
+  bitmap->row_size_bytes = base_bitmap->row_size_bytes;
+  bitmap->resource_id = base_bitmap->resource_id;
+  bitmap->bounds = sub_rect;
+  bitmap->bounds.origin.x += base_bitmap->bounds.origin.x;
+  bitmap->bounds.origin.y += base_bitmap->bounds.origin.y;
+  bitmap->heap = STUB_BITMAP_HEADER;
+  stub_heap_used += bitmap->heap;
+  return bitmap;
+}
+
+GBitmap *gbitmap_create_blank(GSize size)
+{
+  GBitmap *bitmap = calloc(1, sizeof(GBitmap));
+  bitmap->row_size_bytes = (size.w + 31) / 32 * 4;
+  bitmap->bounds = GRect(0, 0, size.w, size.h);
+  bitmap->addr = calloc(size.h, bitmap->row_size_bytes);
+  // bit 0: the stub allocated the pixels
+  bitmap->info_flags = 1;
+  bitmap->heap = STUB_BITMAP_HEADER + bitmap->row_size_bytes * size.h;
+  stub_heap_used += bitmap->heap;
+  return bitmap;
+}
+
+void gbitmap_destroy(GBitmap *bitmap)
+{
+  if (!bitmap) return;
+  stub_heap_used -= bitmap->heap;
+  if (bitmap->info_flags & 1) free(bitmap->addr);
+  free(bitmap);
+}
+
+uint8_t *gbitmap_get_data(const GBitmap *bitmap)
+{
+  return bitmap->addr;
+}
+
+uint16_t gbitmap_get_bytes_per_row(const GBitmap *bitmap)
+{
+  return bitmap->row_size_bytes;
+}
+
+// ---------------------------------------------------------------------------
+// windows and layers
+
+GFont fonts_get_system_font(const char *font_key)
+{
+  return font_key;
+}
+
+Window *window_create(void)
+{
+  Window *window = calloc(1, sizeof(Window));
+#if defined(PBL_ROUND)
+  window->root.frame = GRect(0, 0, 180, 180);
+#else
+  window->root.frame = GRect(0, 0, 144, 168);
+#endif
+  return window;
+}
+
+void window_destroy(Window *window)
+{
+  free(window);
+}
+
+Layer *window_get_root_layer(const Window *window)
+{
+  return (Layer *)&window->root;
+}
+
+void window_set_background_color(Window *window, GColor background_color)
+{
+}
+
+void window_set_window_handlers(Window *window, WindowHandlers handlers)
+{
+  window->handlers = handlers;
+}
+
+void window_stack_push(Window *window, bool animated)
+{
+  if (window->handlers.appear) window->handlers.appear(window);
+}
+
+// layers with an update proc, in creation order, for stub_render()
+#define STUB_MAX_LAYERS 8
+
+static Layer *stub_layers[STUB_MAX_LAYERS];
+
+Layer *layer_create(GRect frame)
+{
+  Layer *layer = calloc(1, sizeof(Layer));
+  layer->frame = frame;
+  for (unsigned int i = 0; i < STUB_MAX_LAYERS; ++i) {
+    if (!stub_layers[i]) {
+      stub_layers[i] = layer;
+      break;
+    }
+  }
+  return layer;
+}
+
+void layer_destroy(Layer *layer)
+{
+  for (unsigned int i = 0; i < STUB_MAX_LAYERS; ++i) {
+    if (stub_layers[i] == layer) stub_layers[i] = NULL;
+  }
+  free(layer);
+}
+
+void layer_set_update_proc(Layer *layer, LayerUpdateProc update_proc)
+{
+  layer->update_proc = update_proc;
+}
+
+void layer_mark_dirty(Layer *layer)
+{
+  ++stub_counters.layer_mark_dirty;
+  layer->dirty = true;
+}
+
+GRect layer_get_bounds(const Layer *layer)
+{
+  return GRect(0, 0, layer->frame.size.w, layer->frame.size.h);
+}
+
+void layer_add_child(Layer *parent, Layer *child)
+{
+}
+
+void layer_set_hidden(Layer *layer, bool hidden)
+{
+  layer->hidden = hidden;
+}
+
+bool layer_get_hidden(const Layer *layer)
+{
+  return layer->hidden;
+}
+
+// ---------------------------------------------------------------------------
+// drawing
+//
+// With stub_draw_enabled the graphics calls draw into a 1-bit frame
+// buffer, 1 white, leftmost pixel in the least significant bit, like
+// aplite's.  Text uses the 5x7 font below scaled by the font size, so
+// frames are legible but no match for the real fonts.
+
+bool stub_draw_enabled = false;
+StubDamage stub_damage;
+
+static uint8_t  stub_frame_pixels[168][20];
+static GBitmap  stub_frame = { stub_frame_pixels, 20, 0, { { 0, 0 }, { 144, 168 } }, 0, 0 };
+
+static bool frame_pixel(int16_t x, int16_t y)
+{
+  return (stub_frame_pixels[y][x >> 3] >> (x & 7)) & 1;
+}
+
+// in screen coordinates, clipped to the layer being drawn
+static void put_pixel(GContext *ctx, int16_t x, int16_t y, bool white)
+{
+  if (x < ctx->clip.origin.x || y < ctx->clip.origin.y ||
+      x >= ctx->clip.origin.x + ctx->clip.size.w || y >= ctx->clip.origin.y + ctx->clip.size.h)
+    return;
+  if (white)
+    stub_frame_pixels[y][x >> 3] |= 1 << (x & 7);
+  else
+    stub_frame_pixels[y][x >> 3] &= ~(1 << (x & 7));
+}
+
+static GRect clip_rect(GRect a, GRect b)
+{
+  int16_t x0 = a.origin.x > b.origin.x ? a.origin.x : b.origin.x;
+  int16_t y0 = a.origin.y > b.origin.y ? a.origin.y : b.origin.y;
+  int16_t x1 = a.origin.x + a.size.w < b.origin.x + b.size.w ? a.origin.x + a.size.w : b.origin.x + b.size.w;
+  int16_t y1 = a.origin.y + a.size.h < b.origin.y + b.size.h ? a.origin.y + a.size.h : b.origin.y + b.size.h;
+  if (x1 < x0) x1 = x0;
+  if (y1 < y0) y1 = y0;
+  return GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void stub_render(void)
+{
+  static uint8_t before[sizeof(stub_frame_pixels)];
+  if (stub_draw_enabled) memcpy(before, stub_frame_pixels, sizeof(before));
+
+  stub_damage = (StubDamage){ 0 };
+  for (unsigned int i = 0; i < STUB_MAX_LAYERS; ++i) {
+    Layer *layer = stub_layers[i];
+    if (!layer || !layer->dirty) continue;
+    layer->dirty = false;
+    if (layer->hidden || !layer->update_proc) continue;
+    GContext ctx = { GCompOpAssign, GColorBlack, GColorBlack, layer->frame.origin,
+                     clip_rect(layer->frame, stub_frame.bounds) };
+    layer->update_proc(layer, &ctx);
+    ++stub_damage.layers;
+  }
+  if (stub_damage.layers) ++stub_counters.frames;
+  if (!stub_draw_enabled) return;
+
+  // what actually changed in the frame buffer
+  int16_t x0 = 144, y0 = 168, x1 = 0, y1 = 0;
+  for (int16_t y = 0; y < 168; ++y) {
+    for (int16_t x = 0; x < 144; ++x) {
+      if (((before[y * 20 + (x >> 3)] >> (x & 7)) & 1) == frame_pixel(x, y)) continue;
+      ++stub_damage.pixels;
+      if (x < x0) x0 = x;
+      if (y < y0) y0 = y;
+      if (x >= x1) x1 = x + 1;
+      if (y >= y1) y1 = y + 1;
+    }
+  }
+  if (stub_damage.pixels) stub_damage.box = GRect(x0, y0, x1 - x0, y1 - y0);
+}
+
+const GBitmap *stub_frame_buffer(void)
+{
+  return &stub_frame;
+}
+
+void graphics_context_set_compositing_mode(GContext *ctx, GCompOp mode)
+{
+  ctx->compositing_mode = mode;
+}
+
+void graphics_context_set_text_color(GContext *ctx, GColor color)
+{
+  ctx->text_color = color;
+}
+
+void graphics_context_set_fill_color(GContext *ctx, GColor color)
+{
+  ctx->fill_color = color;
+}
+
+void graphics_fill_rect(GContext *ctx, GRect rect, uint16_t corner_radius, GCornerMask corner_mask)
+{
+  if (!stub_draw_enabled || ctx->fill_color == GColorClear) return;
+  for (int16_t y = 0; y < rect.size.h; ++y) {
+    for (int16_t x = 0; x < rect.size.w; ++x)
+      put_pixel(ctx, ctx->offset.x + rect.origin.x + x, ctx->offset.y + rect.origin.y + y,
+                ctx->fill_color == GColorWhite);
+  }
+}
+
+static bool bitmap_pixel(const GBitmap *bitmap, int16_t x, int16_t y)
+{
+  const uint8_t *row = (const uint8_t *)bitmap->addr + (bitmap->bounds.origin.y + y) * bitmap->row_size_bytes;
+  x += bitmap->bounds.origin.x;
+  return (row[x >> 3] >> (x & 7)) & 1;
+}
+
+// tiled if rect is bigger than the bitmap, like on the watch
+void graphics_draw_bitmap_in_rect(GContext *ctx, const GBitmap *bitmap, GRect rect)
+{
+  ++stub_counters.draw_bitmap;
+  if (!stub_draw_enabled || !bitmap->addr || bitmap->bounds.size.w <= 0 || bitmap->bounds.size.h <= 0)
+    return;
+  for (int16_t y = 0; y < rect.size.h; ++y) {
+    for (int16_t x = 0; x < rect.size.w; ++x) {
+      int16_t fx = ctx->offset.x + rect.origin.x + x, fy = ctx->offset.y + rect.origin.y + y;
+      if (fx < 0 || fy < 0 || fx >= 144 || fy >= 168) continue;
+      bool src = bitmap_pixel(bitmap, x % bitmap->bounds.size.w, y % bitmap->bounds.size.h);
+      bool dst = frame_pixel(fx, fy);
+      switch (ctx->compositing_mode) {
+      case GCompOpAssign:         dst = src;         break;
+      case GCompOpAssignInverted: dst = !src;        break;
+      case GCompOpOr:             dst = dst || src;  break;
+      case GCompOpAnd:            dst = dst && src;  break;
+      case GCompOpClear:          dst = dst && !src; break;
+      case GCompOpSet:            dst = dst || !src; break;
+      }
+      put_pixel(ctx, fx, fy, dst);
+    }
+  }
+}
+
+// 5x7 font for ' ' to 'Z', one byte per column, top row in bit 0;
+// lower case is drawn as upper case, anything else as a box
+static const uint8_t stub_font[][5] = {
+  { 0x00, 0x00, 0x00, 0x00, 0x00 }, { 0x00, 0x00, 0x5F, 0x00, 0x00 }, { 0x00, 0x07, 0x00, 0x07, 0x00 },
+  { 0x14, 0x7F, 0x14, 0x7F, 0x14 }, { 0x24, 0x2A, 0x7F, 0x2A, 0x12 }, { 0x23, 0x13, 0x08, 0x64, 0x62 },
+  { 0x36, 0x49, 0x55, 0x22, 0x50 }, { 0x00, 0x05, 0x03, 0x00, 0x00 }, { 0x00, 0x1C, 0x22, 0x41, 0x00 },
+  { 0x00, 0x41, 0x22, 0x1C, 0x00 }, { 0x14, 0x08, 0x3E, 0x08, 0x14 }, { 0x08, 0x08, 0x3E, 0x08, 0x08 },
+  { 0x00, 0x50, 0x30, 0x00, 0x00 }, { 0x08, 0x08, 0x08, 0x08, 0x08 }, { 0x00, 0x60, 0x60, 0x00, 0x00 },
+  { 0x20, 0x10, 0x08, 0x04, 0x02 },
+  // 0-9
+  { 0x3E, 0x51, 0x49, 0x45, 0x3E }, { 0x00, 0x42, 0x7F, 0x40, 0x00 }, { 0x42, 0x61, 0x51, 0x49, 0x46 },
+  { 0x21, 0x41, 0x45, 0x4B, 0x31 }, { 0x18, 0x14, 0x12, 0x7F, 0x10 }, { 0x27, 0x45, 0x45, 0x45, 0x39 },
+  { 0x3C, 0x4A, 0x49, 0x49, 0x30 }, { 0x01, 0x71, 0x09, 0x05, 0x03 }, { 0x36, 0x49, 0x49, 0x49, 0x36 },
+  { 0x06, 0x49, 0x49, 0x29, 0x1E },
+  { 0x00, 0x36, 0x36, 0x00, 0x00 }, { 0x00, 0x56, 0x36, 0x00, 0x00 }, { 0x08, 0x14, 0x22, 0x41, 0x00 },
+  { 0x14, 0x14, 0x14, 0x14, 0x14 }, { 0x00, 0x41, 0x22, 0x14, 0x08 }, { 0x02, 0x01, 0x51, 0x09, 0x06 },
+  { 0x32, 0x49, 0x79, 0x41, 0x3E },
+  // A-Z
+  { 0x7E, 0x11, 0x11, 0x11, 0x7E }, { 0x7F, 0x49, 0x49, 0x49, 0x36 }, { 0x3E, 0x41, 0x41, 0x41, 0x22 },
+  { 0x7F, 0x41, 0x41, 0x22, 0x1C }, { 0x7F, 0x49, 0x49, 0x49, 0x41 }, { 0x7F, 0x09, 0x09, 0x09, 0x01 },
+  { 0x3E, 0x41, 0x49, 0x49, 0x7A }, { 0x7F, 0x08, 0x08, 0x08, 0x7F }, { 0x00, 0x41, 0x7F, 0x41, 0x00 },
+  { 0x20, 0x40, 0x41, 0x3F, 0x01 }, { 0x7F, 0x08, 0x14, 0x22, 0x41 }, { 0x7F, 0x40, 0x40, 0x40, 0x40 },
+  { 0x7F, 0x02, 0x0C, 0x02, 0x7F }, { 0x7F, 0x04, 0x08, 0x10, 0x7F }, { 0x3E, 0x41, 0x41, 0x41, 0x3E },
+  { 0x7F, 0x09, 0x09, 0x09, 0x06 }, { 0x3E, 0x41, 0x51, 0x21, 0x5E }, { 0x7F, 0x09, 0x19, 0x29, 0x46 },
+  { 0x46, 0x49, 0x49, 0x49, 0x31 }, { 0x01, 0x01, 0x7F, 0x01, 0x01 }, { 0x3F, 0x40, 0x40, 0x40, 0x3F },
+  { 0x1F, 0x20, 0x40, 0x20, 0x1F }, { 0x3F, 0x40, 0x38, 0x40, 0x3F }, { 0x63, 0x14, 0x08, 0x14, 0x63 },
+  { 0x07, 0x08, 0x70, 0x08, 0x07 }, { 0x61, 0x51, 0x49, 0x45, 0x43 },
+};
+static const uint8_t stub_font_box[5] = { 0x7F, 0x41, 0x41, 0x41, 0x7F };
+
+static const uint8_t *font_glyph(char c)
+{
+  if (c >= 'a' && c <= 'z') c -= 'a' - 'A';
+  if (c >= ' ' && c <= 'Z') return stub_font[c - ' '];
+  return stub_font_box;
+}
+
+// font keys end in their size, e.g. "..._34_MEDIUM_NUMBERS"; a 5x7 cell
+// is scaled by a fourteenth of it, which keeps text in the face's boxes
+static int16_t font_scale(GFont font)
+{
+  int16_t size = 24;
+  for (const char *c = font; *c; ++c) {
+    if (*c >= '0' && *c <= '9') {
+      size = atoi(c);
+      break;
+    }
+  }
+  return size >= 28 ? size / 14 : 1;
+}
+
+// the glyph's inked columns, [first, last); a space is two blank ones
+static void glyph_columns(char c, int16_t *first, int16_t *last)
+{
+  const uint8_t *glyph = font_glyph(c);
+  *first = 0;
+  *last = 0;
+  for (int16_t i = 0; i < 5; ++i) {
+    if (glyph[i]) {
+      if (*last == 0) *first = i;
+      *last = i + 1;
+    }
+  }
+  if (*last == 0) *last = 2;
+}
+
+static int16_t char_advance(char c, int16_t scale)
+{
+  int16_t first, last;
+  glyph_columns(c, &first, &last);
+  return (last - first + 1) * scale;
+}
+
+#define STUB_TEXT_LINES 8
+
+typedef struct {
+  const char *start;
+  int16_t     length;
+  int16_t     width;
+} TextLine;
+
+// word wrap text into box width; returns the number of lines
+static int text_layout(const char *text, int16_t scale, int16_t box_w, TextLine *lines)
+{
+  int n = 0;
+  const char *c = text;
+  while (*c && n < STUB_TEXT_LINES) {
+    TextLine line = { c, 0, 0 };
+    // whole words while they fit, or at least one
+    const char *end = c;
+    int16_t width = 0;
+    while (*end && *end != '\n') {
+      const char *word = end;
+      int16_t word_w = 0;
+      if (*word == ' ') word_w += char_advance(*word++, scale);
+      while (*word && *word != ' ' && *word != '\n') word_w += char_advance(*word++, scale);
+      if (line.length && width + word_w > box_w) break;
+      width += word_w;
+      line.length = word - c;
+      end = word;
+    }
+    line.width = width;
+    lines[n++] = line;
+    c = end;
+    if (*c == '\n' || *c == ' ') ++c;
+  }
+  return n;
+}
+
+static void draw_glyph(GContext *ctx, char c, int16_t x, int16_t y, int16_t scale, GRect box)
+{
+  const uint8_t *glyph = font_glyph(c);
+  int16_t first, last;
+  glyph_columns(c, &first, &last);
+  for (int16_t col = first; col < last && col < 5; ++col) {
+    for (int16_t row = 0; row < 7; ++row) {
+      if (!((glyph[col] >> row) & 1)) continue;
+      for (int16_t dy = 0; dy < scale; ++dy) {
+        for (int16_t dx = 0; dx < scale; ++dx) {
+          int16_t px = x + (col - first) * scale + dx, py = y + row * scale + dy;
+          if (px < box.origin.x || py < box.origin.y ||
+              px >= box.origin.x + box.size.w || py >= box.origin.y + box.size.h)
+            continue;
+          put_pixel(ctx, ctx->offset.x + px, ctx->offset.y + py, ctx->text_color == GColorWhite);
+        }
+      }
+    }
+  }
+}
+
+void graphics_draw_text(GContext *ctx, const char *text, GFont font, GRect box,
+                        GTextOverflowMode overflow_mode, GTextAlignment alignment,
+                        GTextLayoutCacheRef layout)
+{
+  ++stub_counters.draw_text;
+  if (!stub_draw_enabled || ctx->text_color == GColorClear) return;
+
+  int16_t scale = font_scale(font);
+  TextLine lines[STUB_TEXT_LINES];
+  int n = text_layout(text, scale, box.size.w, lines);
+  for (int i = 0; i < n; ++i) {
+    int16_t x = box.origin.x, y = box.origin.y + i * 9 * scale;
+    if (alignment == GTextAlignmentRight)
+      x += box.size.w - lines[i].width;
+    else if (alignment == GTextAlignmentCenter)
+      x += (box.size.w - lines[i].width) / 2;
+    for (int16_t j = 0; j < lines[i].length; ++j) {
+      draw_glyph(ctx, lines[i].start[j], x, y, scale, box);
+      x += char_advance(lines[i].start[j], scale);
+    }
+  }
+}
+
+GSize graphics_text_layout_get_content_size(const char *text, GFont font, GRect box,
+                                            GTextOverflowMode overflow_mode, GTextAlignment alignment)
+{
+  int16_t scale = font_scale(font);
+  TextLine lines[STUB_TEXT_LINES];
+  int n = text_layout(text, scale, box.size.w, lines);
+  int16_t w = 0;
+  for (int i = 0; i < n; ++i) {
+    if (lines[i].width > w) w = lines[i].width;
+  }
+  if (w > box.size.w) w = box.size.w;
+  return GSize(w, n * 9 * scale);
+}
+
+GBitmap *graphics_capture_frame_buffer(GContext *ctx)
+{
+  return &stub_frame;
+}
+
+bool graphics_release_frame_buffer(GContext *ctx, GBitmap *buffer)
+{
+  return buffer == &stub_frame;
+}
+
+// ---------------------------------------------------------------------------
+// event services
+
+static TickHandler stub_tick_handler;
+static BatteryStateHandler stub_battery_handler;
+static BluetoothConnectionHandler stub_bluetooth_handler;
+static AccelTapHandler stub_tap_handler;
+
+TimeUnits stub_tick_units;
+
+void tick_timer_service_subscribe(TimeUnits tick_units, TickHandler handler)
+{
+  stub_tick_units = tick_units;
+  stub_tick_handler = handler;
+}
+
+void tick_timer_service_unsubscribe(void)
+{
+  stub_tick_units = 0;
+  stub_tick_handler = NULL;
+}
+
+void stub_tick(struct tm *tick_time, TimeUnits units_changed)
+{
+  if (stub_tick_handler && (units_changed & stub_tick_units)) {
+    ++stub_counters.ticks;
+    stub_tick_handler(tick_time, units_changed);
+  }
+}
+
+void stub_battery_event(BatteryChargeState charge)
+{
+  stub_battery_state = charge;
+  if (stub_battery_handler) stub_battery_handler(charge);
+}
+
+void stub_bluetooth_event(bool connected)
+{
+  stub_bluetooth_connected = connected;
+  if (stub_bluetooth_handler) stub_bluetooth_handler(connected);
+}
+
+void accel_tap_service_subscribe(AccelTapHandler handler)
+{
+  stub_tap_handler = handler;
+}
+
+void accel_tap_service_unsubscribe(void)
+{
+  stub_tap_handler = NULL;
+}
+
+void stub_tap_event(void)
+{
+  if (stub_tap_handler) stub_tap_handler(ACCEL_AXIS_Z, 1);
+}
+
+void battery_state_service_subscribe(BatteryStateHandler handler)
+{
+  stub_battery_handler = handler;
+}
+
+void battery_state_service_unsubscribe(void)
+{
+  stub_battery_handler = NULL;
+}
+
+BatteryChargeState battery_state_service_peek(void)
+{
+  return stub_battery_state;
+}
+
+void bluetooth_connection_service_subscribe(BluetoothConnectionHandler handler)
+{
+  stub_bluetooth_handler = handler;
+}
+
+void bluetooth_connection_service_unsubscribe(void)
+{
+  stub_bluetooth_handler = NULL;
+}
+
+bool bluetooth_connection_service_peek(void)
+{
+  return stub_bluetooth_connected;
+}
+
+// ---------------------------------------------------------------------------
+// timers
+
+#define STUB_TIMER_SLOTS 16
+
+struct AppTimer {
+  bool             used;
+  uint64_t         due_ms;
+  AppTimerCallback callback;
+  void            *data;
+};
+
+static AppTimer stub_timers[STUB_TIMER_SLOTS];
+
+static bool     stub_uptime_set = false;
+static uint64_t stub_uptime = 0;
+
+void stub_set_uptime_ms(uint64_t uptime_ms)
+{
+  stub_uptime_set = true;
+  stub_uptime = uptime_ms;
+}
+
+// timers run on the uptime clock, which is the watch clock unless set
+static uint64_t stub_now_ms(void)
+{
+  return stub_uptime_set ? stub_uptime : (uint64_t)stub_now * 1000;
+}
+
+uint16_t time_ms(time_t *tloc, uint16_t *out_ms)
+{
+  uint16_t ms = stub_now_ms() % 1000;
+  if (tloc) *tloc = stub_now;
+  if (out_ms) *out_ms = ms;
+  return ms;
+}
+
+AppTimer *app_timer_register(uint32_t timeout_ms, AppTimerCallback callback, void *callback_data)
+{
+  for (int i = 0; i < STUB_TIMER_SLOTS; ++i) {
+    if (!stub_timers[i].used) {
+      stub_timers[i] = (AppTimer){ true, stub_now_ms() + timeout_ms, callback, callback_data };
+      return &stub_timers[i];
+    }
+  }
+  return NULL;
+}
+
+bool app_timer_reschedule(AppTimer *timer_handle, uint32_t new_timeout_ms)
+{
+  if (!timer_handle || !timer_handle->used) return false;
+  timer_handle->due_ms = stub_now_ms() + new_timeout_ms;
+  return true;
+}
+
+void app_timer_cancel(AppTimer *timer_handle)
+{
+  if (timer_handle) timer_handle->used = false;
+}
+
+bool stub_next_timer_ms(uint64_t *due_ms)
+{
+  bool found = false;
+  for (int i = 0; i < STUB_TIMER_SLOTS; ++i) {
+    if (stub_timers[i].used && (!found || stub_timers[i].due_ms < *due_ms)) {
+      *due_ms = stub_timers[i].due_ms;
+      found = true;
+    }
+  }
+  return found;
+}
+
+void stub_run_timers(void)
+{
+  // callbacks may register new timers, so rescan until nothing is due
+  bool fired = true;
+  while (fired) {
+    fired = false;
+    for (int i = 0; i < STUB_TIMER_SLOTS; ++i) {
+      AppTimer *timer = &stub_timers[i];
+      if (timer->used && timer->due_ms <= stub_now_ms()) {
+        timer->used = false;
+        ++stub_counters.timers_fired;
+        timer->callback(timer->data);
+        fired = true;
+      }
+    }
+  }
+}
+
+// ---------------------------------------------------------------------------
+// persistent storage
+
+#define STUB_PERSIST_SLOTS 128
+
+typedef struct {
+  bool     used;
+  uint32_t key;
+  size_t   size;
+  uint8_t  data[PERSIST_DATA_MAX_LENGTH];
+} StubPersistSlot;
+
+static StubPersistSlot stub_persist[STUB_PERSIST_SLOTS];
+
+static StubPersistSlot *persist_find(uint32_t key)
+{
+  for (int i = 0; i < STUB_PERSIST_SLOTS; ++i) {
+    if (stub_persist[i].used && stub_persist[i].key == key) return &stub_persist[i];
+  }
+  return NULL;
+}
+
+static StubPersistSlot *persist_slot(uint32_t key)
+{
+  StubPersistSlot *slot = persist_find(key);
+  for (int i = 0; !slot && i < STUB_PERSIST_SLOTS; ++i) {
+    if (!stub_persist[i].used) {
+      slot = &stub_persist[i];
+      slot->used = true;
+      slot->key = key;
+    }
+  }
+  return slot;
+}
+
+void stub_persist_clear(void)
+{
+  memset(stub_persist, 0, sizeof(stub_persist));
+}
+
+bool persist_exists(const uint32_t key)
+{
+  ++stub_counters.persist_exists;
+  return persist_find(key) != NULL;
+}
+
+int persist_read_data(const uint32_t key, void *buffer, const size_t buffer_size)
+{
+  ++stub_counters.persist_reads;
+  StubPersistSlot *slot = persist_find(key);
+  if (!slot) return -1;
+  size_t size = slot->size < buffer_size ? slot->size : buffer_size;
+  memcpy(buffer, slot->data, size);
+  return (int)size;
+}
+
+bool persist_read_bool(const uint32_t key)
+{
+  bool value = false;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+int32_t persist_read_int(const uint32_t key)
+{
+  int32_t value = 0;
+  persist_read_data(key, &value, sizeof(value));
+  return value;
+}
+
+int persist_write_data(const uint32_t key, const void *data, const size_t size)
+{
+  ++stub_counters.persist_writes;
+  StubPersistSlot *slot = persist_slot(key);
+  if (!slot || size > PERSIST_DATA_MAX_LENGTH) return -1;
+  memcpy(slot->data, data, size);
+  slot->size = size;
+  return (int)size;
+}
+
+int persist_write_bool(const uint32_t key, const bool value)
+{
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_write_int(const uint32_t key, const int32_t value)
+{
+  return persist_write_data(key, &value, sizeof(value));
+}
+
+int persist_delete(const uint32_t key)
+{
+  StubPersistSlot *slot = persist_find(key);
+  if (slot) slot->used = false;
+  return 0;
+}
+
+// ---------------------------------------------------------------------------
+// AppMessage / AppSync
+
+static AppSync *stub_sync;
+
+static size_t   stub_app_message_heap;
+static uint32_t stub_outbox_size;
+static uint8_t *stub_outbox;
+static DictionaryIterator stub_outbox_iter;
+static bool     stub_outbox_pending;
+static AppMessageOutboxSent   stub_outbox_sent;
+static AppMessageOutboxFailed stub_outbox_failed;
+
+// a count byte, then key, type and length ahead of each value
+static DictionaryResult dict_write(DictionaryIterator *iter, uint32_t key, TupleType type,
+                                   const void *data, uint16_t size)
+{
+  if (iter->cursor + sizeof(Tuple) + size > iter->end) return DICT_NOT_ENOUGH_STORAGE;
+  Tuple tuple = { key, type, size };
+  memcpy(iter->cursor, &tuple, sizeof(Tuple));
+  memcpy(iter->cursor + sizeof(Tuple), data, size);
+  iter->cursor += sizeof(Tuple) + size;
+  ++iter->count;
+  return DICT_OK;
+}
+
+DictionaryResult dict_write_uint8(DictionaryIterator *iter, const uint32_t key, const uint8_t value)
+{
+  return dict_write(iter, key, TUPLE_UINT, &value, sizeof(value));
+}
+
+DictionaryResult dict_write_data(DictionaryIterator *iter, const uint32_t key, const uint8_t * const data,
+                                 const uint16_t size)
+{
+  return dict_write(iter, key, TUPLE_BYTE_ARRAY, data, size);
+}
+
+uint32_t app_message_inbox_size_maximum(void)
+{
+  return 2026;
+}
+
+uint32_t app_message_outbox_size_maximum(void)
+{
+  return 656;
+}
+
+void stub_app_message_close(void)
+{
+  stub_heap_used -= stub_app_message_heap;
+  stub_app_message_heap = 0;
+  free(stub_outbox);
+  stub_outbox = NULL;
+  stub_outbox_pending = false;
+  stub_outbox_sent = NULL;
+  stub_outbox_failed = NULL;
+}
+
+AppMessageResult app_message_open(const uint32_t size_inbound, const uint32_t size_outbound)
+{
+  stub_app_message_close();
+  stub_app_message_heap = size_inbound + size_outbound;
+  stub_heap_used += stub_app_message_heap;
+  stub_outbox_size = size_outbound;
+  stub_outbox = malloc(size_outbound);
+  return APP_MSG_OK;
+}
+
+AppMessageOutboxSent app_message_register_outbox_sent(AppMessageOutboxSent sent_callback)
+{
+  AppMessageOutboxSent previous = stub_outbox_sent;
+  stub_outbox_sent = sent_callback;
+  return previous;
+}
+
+AppMessageOutboxFailed app_message_register_outbox_failed(AppMessageOutboxFailed failed_callback)
+{
+  AppMessageOutboxFailed previous = stub_outbox_failed;
+  stub_outbox_failed = failed_callback;
+  return previous;
+}
+
+AppMessageResult app_message_outbox_begin(DictionaryIterator **iterator)
+{
+  if (!stub_outbox) return APP_MSG_INVALID_ARGS;
+  if (stub_outbox_pending) return APP_MSG_BUSY;
+  stub_outbox_iter = (DictionaryIterator){ stub_outbox + 1, stub_outbox + stub_outbox_size, 0 };
+  *iterator = &stub_outbox_iter;
+  return APP_MSG_OK;
+}
+
+AppMessageResult app_message_outbox_send(void)
+{
+  if (!stub_outbox || stub_outbox_pending) return APP_MSG_BUSY;
+  stub_outbox[0] = stub_outbox_iter.count;
+  stub_outbox_pending = true;
+  ++stub_counters.app_messages;
+  return APP_MSG_OK;
+}
+
+bool stub_app_message_pending(void)
+{
+  return stub_outbox_pending;
+}
+
+size_t stub_app_message_size(void)
+{
+  return stub_outbox_iter.cursor - stub_outbox;
+}
+
+const Tuple *stub_app_message_find(uint32_t key)
+{
+  if (!stub_outbox_pending) return NULL;
+  const uint8_t *cursor = stub_outbox + 1;
+  for (uint8_t i = 0; i < stub_outbox[0]; ++i) {
+    const Tuple *tuple = (const Tuple *)cursor;
+    if (tuple->key == key) return tuple;
+    cursor += sizeof(Tuple) + tuple->length;
+  }
+  return NULL;
+}
+
+void stub_app_message_complete(AppMessageResult result)
+{
+  if (!stub_outbox_pending) return;
+  stub_outbox_pending = false;
+  if (result == APP_MSG_OK) {
+    if (stub_outbox_sent) stub_outbox_sent(&stub_outbox_iter, NULL);
+  } else {
+    if (stub_outbox_failed) stub_outbox_failed(&stub_outbox_iter, result, NULL);
+  }
+}
+
+// AppSync keeps the dictionary in the app's buffer, as on the watch: a
+// count byte, then the tuples.  A tuple replaces the one with its key in
+// place, and one that would take the dictionary past buffer_size is
+// dropped with DICT_NOT_ENOUGH_STORAGE.
+static void sync_deliver(AppSync *s, uint32_t key, TupleType type, const void *data, uint16_t length)
+{
+  union {
+    Tuple   tuple;
+    uint8_t raw[sizeof(Tuple) + 256];
+  } old;
+  bool had_old = false;
+  uint8_t *cursor = s->buffer + 1, *found = NULL;
+  for (uint8_t i = 0; i < s->buffer[0]; ++i) {
+    const Tuple *tuple = (const Tuple *)cursor;
+    if (tuple->key == key) found = cursor;
+    cursor += sizeof(Tuple) + tuple->length;
+  }
+  size_t used = cursor - s->buffer;
+  size_t old_size = 0;
+  if (found) {
+    old_size = sizeof(Tuple) + ((const Tuple *)found)->length;
+    if (old_size <= sizeof(old)) {
+      memcpy(old.raw, found, old_size);
+      had_old = true;
+    }
+  }
+  if (used - old_size + sizeof(Tuple) + length > s->buffer_size) {
+    if (s->error) s->error(DICT_NOT_ENOUGH_STORAGE, APP_MSG_OK, s->context);
+    return;
+  }
+
+  Tuple *tuple;
+  if (found) {
+    // shift what follows to fit the new length
+    uint8_t *next = found + old_size;
+    memmove(found + sizeof(Tuple) + length, next, cursor - next);
+    tuple = (Tuple *)found;
+  } else {
+    tuple = (Tuple *)cursor;
+    ++s->buffer[0];
+  }
+  tuple->key = key;
+  tuple->type = type;
+  tuple->length = length;
+  memcpy(tuple->value->data, data, length);
+  if (s->tuple_changed) s->tuple_changed(key, tuple, had_old ? &old.tuple : NULL, s->context);
+}
+
+void app_sync_init(AppSync *s, uint8_t *buffer, const uint16_t buffer_size,
+                   const Tuplet * const keys_and_initial_values, const uint8_t count,
+                   AppSyncTupleChangedCallback tuple_changed_callback,
+                   AppSyncErrorCallback error_callback, void *context)
+{
+  s->tuple_changed = tuple_changed_callback;
+  s->error = error_callback;
+  s->context = context;
+  s->buffer = buffer;
+  s->buffer_size = buffer_size;
+  stub_sync = s;
+  if (buffer_size == 0) return;
+  buffer[0] = 0;
+
+  // like the SDK, report every initial value as a change
+  for (uint8_t i = 0; i < count; ++i) {
+    const Tuplet *t = &keys_and_initial_values[i];
+    if (t->type == TUPLE_BYTE_ARRAY) {
+      sync_deliver(s, t->key, t->type, t->bytes.data, t->bytes.length);
+    } else {
+      // integers are little endian, like on the watch
+      sync_deliver(s, t->key, t->type, &t->integer.storage, t->integer.width);
+    }
+  }
+}
+
+void app_sync_deinit(AppSync *s)
+{
+  if (stub_sync == s) stub_sync = NULL;
+}
+
+void stub_app_sync_receive(uint32_t key, int32_t value)
+{
+  // little endian, like on the watch
+  if (stub_sync) sync_deliver(stub_sync, key, TUPLE_INT, &value, sizeof(value));
+}
+
+void stub_app_sync_receive_bytes(uint32_t key, const uint8_t *data, uint16_t length)
+{
+  if (stub_sync) sync_deliver(stub_sync, key, TUPLE_BYTE_ARRAY, data, length);
+}
+
+void app_event_loop(void)
+{
+}
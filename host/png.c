@@ -0,0 +1,242 @@
+//  file: png.c
+//  See png.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <zlib.h>
+#include "png.h"
+
+static const uint8_t png_signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1a, '\n' };
+
+static uint32_t get_u32(const uint8_t *p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+static void put_u32(uint8_t *p, uint32_t value)
+{
+  p[0] = value >> 24;
+  p[1] = value >> 16;
+  p[2] = value >> 8;
+  p[3] = value;
+}
+
+static uint8_t paeth(uint8_t a, uint8_t b, uint8_t c)
+{
+  int p = a + b - c;
+  int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+  if (pa <= pb && pa <= pc) return a;
+  return (pb <= pc) ? b : c;
+}
+
+// undo the per-row filters in place; rows are stride bytes plus the
+// filter type byte in front
+static bool unfilter(uint8_t *raw, uint16_t height, size_t stride, size_t bpp)
+{
+  const uint8_t *prev = NULL;
+  for (uint16_t y = 0; y < height; ++y) {
+    uint8_t *row = raw + y * (stride + 1);
+    uint8_t kind = row[0];
+    uint8_t *line = row + 1;
+    for (size_t x = 0; x < stride; ++x) {
+      uint8_t a = (x >= bpp) ? line[x - bpp] : 0;
+      uint8_t b = prev ? prev[x] : 0;
+      uint8_t c = (prev && x >= bpp) ? prev[x - bpp] : 0;
+      switch (kind) {
+      case 0: break;
+      case 1: line[x] += a; break;
+      case 2: line[x] += b; break;
+      case 3: line[x] += (a + b) >> 1; break;
+      case 4: line[x] += paeth(a, b, c); break;
+      default: return false;
+      }
+    }
+    prev = line;
+  }
+  return true;
+}
+
+// sample n of a row of depth-bit samples, most significant first
+static uint16_t sample(const uint8_t *line, size_t n, uint8_t depth)
+{
+  if (depth == 8) return line[n];
+  size_t bit = n * depth;
+  return (line[bit >> 3] >> (8 - depth - (bit & 7))) & ((1 << depth) - 1);
+}
+
+static uint8_t luma(uint16_t r, uint16_t g, uint16_t b)
+{
+  return (r * 299 + g * 587 + b * 114) / 1000;
+}
+
+// over white
+static uint8_t flatten(uint8_t grey, uint16_t alpha)
+{
+  return (grey * alpha + 255 * (255 - alpha)) / 255;
+}
+
+bool png_decode(const uint8_t *data, size_t size, PngImage *image)
+{
+  static const uint8_t channels_for[7] = { 1, 0, 3, 1, 2, 0, 4 };
+  uint32_t width = 0, height = 0;
+  uint8_t depth = 0, colour = 0;
+  uint8_t palette[256][4];
+  uint8_t *idat = NULL;
+  size_t idat_size = 0;
+
+  memset(image, 0, sizeof(*image));
+  memset(palette, 0xFF, sizeof(palette));
+  if (size < 8 || memcmp(data, png_signature, 8) != 0) return false;
+
+  for (size_t pos = 8; pos + 12 <= size; ) {
+    uint32_t length = get_u32(data + pos);
+    const uint8_t *kind = data + pos + 4, *body = data + pos + 8;
+    if (length > size - pos - 12) break;
+    if (memcmp(kind, "IHDR", 4) == 0 && length >= 13) {
+      width = get_u32(body);
+      height = get_u32(body + 4);
+      depth = body[8];
+      colour = body[9];
+      // no interlacing, no 16-bit samples
+      if (body[12] != 0 || depth > 8 || colour > 6 || channels_for[colour] == 0) goto fail;
+    } else if (memcmp(kind, "PLTE", 4) == 0) {
+      for (uint32_t i = 0; i < length / 3 && i < 256; ++i) {
+        palette[i][0] = body[3*i];
+        palette[i][1] = body[3*i + 1];
+        palette[i][2] = body[3*i + 2];
+      }
+    } else if (memcmp(kind, "tRNS", 4) == 0 && colour == 3) {
+      for (uint32_t i = 0; i < length && i < 256; ++i) palette[i][3] = body[i];
+    } else if (memcmp(kind, "IDAT", 4) == 0) {
+      idat = realloc(idat, idat_size + length);
+      memcpy(idat + idat_size, body, length);
+      idat_size += length;
+    }
+    pos += 12 + length;
+  }
+  if (width == 0 || height == 0 || width > 0xFFFF || height > 0xFFFF || !idat) goto fail;
+
+  uint8_t channels = channels_for[colour];
+  size_t stride = (width * channels * depth + 7) / 8;
+  size_t bpp = (channels * depth + 7) / 8;
+  uLongf raw_size = (stride + 1) * height;
+  uint8_t *raw = malloc(raw_size);
+  if (uncompress(raw, &raw_size, idat, idat_size) != Z_OK || raw_size != (stride + 1) * height ||
+      !unfilter(raw, height, stride, bpp)) {
+    free(raw);
+    goto fail;
+  }
+
+  image->width = width;
+  image->height = height;
+  image->grey = malloc(width * height);
+  for (uint32_t y = 0; y < height; ++y) {
+    const uint8_t *line = raw + y * (stride + 1) + 1;
+    for (uint32_t x = 0; x < width; ++x) {
+      uint8_t grey, alpha = 255;
+      uint16_t max = (1 << depth) - 1;
+      switch (colour) {
+      case 0:
+        grey = sample(line, x, depth) * 255 / max;
+        break;
+      case 2:
+        grey = luma(line[3*x], line[3*x + 1], line[3*x + 2]);
+        break;
+      case 3: {
+        const uint8_t *entry = palette[sample(line, x, depth)];
+        grey = luma(entry[0], entry[1], entry[2]);
+        alpha = entry[3];
+        break;
+      }
+      case 4:
+        grey = line[2*x];
+        alpha = line[2*x + 1];
+        break;
+      default:
+        grey = luma(line[4*x], line[4*x + 1], line[4*x + 2]);
+        alpha = line[4*x + 3];
+        break;
+      }
+      image->grey[y * width + x] = flatten(grey, alpha);
+    }
+  }
+  free(raw);
+  free(idat);
+  return true;
+
+fail:
+  free(idat);
+  return false;
+}
+
+bool png_load(const char *path, PngImage *image)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  fseek(f, 0, SEEK_END);
+  long size = ftell(f);
+  fseek(f, 0, SEEK_SET);
+  uint8_t *data = malloc(size > 0 ? size : 1);
+  bool ok = (size > 0) && (fread(data, 1, size, f) == (size_t)size) && png_decode(data, size, image);
+  fclose(f);
+  free(data);
+  return ok;
+}
+
+void png_free(PngImage *image)
+{
+  free(image->grey);
+  image->grey = NULL;
+}
+
+static void write_chunk(FILE *f, const char *kind, const uint8_t *body, uint32_t length)
+{
+  uint8_t header[8];
+  put_u32(header, length);
+  memcpy(header + 4, kind, 4);
+  uLong crc = crc32(0, header + 4, 4);
+  if (length) crc = crc32(crc, body, length);
+  uint8_t trailer[4];
+  put_u32(trailer, crc);
+  fwrite(header, 1, 8, f);
+  if (length) fwrite(body, 1, length, f);
+  fwrite(trailer, 1, 4, f);
+}
+
+bool png_write_1bit(const char *path, uint16_t width, uint16_t height,
+                    const uint8_t *rows, uint16_t row_size)
+{
+  // PNG wants the leftmost pixel in the most significant bit
+  size_t stride = (width + 7) / 8;
+  uLongf raw_size = (stride + 1) * height;
+  uint8_t *raw = calloc(1, raw_size);
+  for (uint16_t y = 0; y < height; ++y) {
+    uint8_t *line = raw + y * (stride + 1) + 1;
+    for (uint16_t x = 0; x < width; ++x) {
+      if (rows[y * row_size + (x >> 3)] & (1 << (x & 7))) line[x >> 3] |= 0x80 >> (x & 7);
+    }
+  }
+  uLongf packed_size = compressBound(raw_size);
+  uint8_t *packed = malloc(packed_size);
+  int z = compress2(packed, &packed_size, raw, raw_size, 9);
+  free(raw);
+
+  FILE *f = fopen(path, "wb");
+  if (z != Z_OK || !f) {
+    free(packed);
+    if (f) fclose(f);
+    return false;
+  }
+  // 1-bit greyscale
+  uint8_t ihdr[13] = { 0 };
+  put_u32(ihdr, width);
+  put_u32(ihdr + 4, height);
+  ihdr[8] = 1;
+  fwrite(png_signature, 1, 8, f);
+  write_chunk(f, "IHDR", ihdr, sizeof(ihdr));
+  write_chunk(f, "IDAT", packed, packed_size);
+  write_chunk(f, "IEND", NULL, 0);
+  free(packed);
+  return fclose(f) == 0;
+}
@@ -0,0 +1,28 @@
+//  file: png.h
+//  Just enough PNG for the host renderer, on top of zlib
+//
+//  png_decode() reads the non-interlaced images in resources/ into one
+//  grey byte per pixel, transparency composited over white the way the
+//  aplite resource converter flattens it.  png_write_1bit() writes a
+//  1-bit frame buffer, which is all the host ever writes.
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+  uint16_t width;
+  uint16_t height;
+  // width * height bytes, 0 black .. 255 white
+  uint8_t *grey;
+} PngImage;
+
+bool png_decode(const uint8_t *data, size_t size, PngImage *image);
+bool png_load(const char *path, PngImage *image);
+void png_free(PngImage *image);
+
+// rows of 1-bit pixels, leftmost in the least significant bit, 1 white
+bool png_write_1bit(const char *path, uint16_t width, uint16_t height,
+                    const uint8_t *rows, uint16_t row_size);
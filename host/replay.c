@@ -0,0 +1,388 @@
+//  file: replay.c
+//  Time-warp replay of countdown.c through years of the event schedule
+//
+//  Like bench_tick.c, countdown.c is compiled straight into this file.
+//  We run the watch clock from REPLAY_FROM to REPLAY_TO, delivering every
+//  tick the refresh policy subscribes to (so a day of minute ticks costs
+//  1440 steps, not 86400) and stopping in between for timers, drawing
+//  each frame.
+//  Along the way the scenario below toggles events, drains the battery,
+//  drops Bluetooth and taps the wrist.
+//
+//  SDK2 watches keep local time, so the phone's DST changes show up as
+//  the watch clock jumping an hour forward or back; the time zone (--tz,
+//  REPLAY_TZ by default) decides when.  SDK3 firmware keeps UTC instead
+//  and localtime() applies the zone; --clock utc replays that, and then
+//  the catalog's local dates fall on different UTC instants for every
+//  zone.  Either way the files below are in watch local time.
+//
+//  Two files come out:
+//    transitions.txt  every change of the countdown text, and every
+//                     scenario step, with the watch time it happened at
+//    budget.txt       per watch day: wakeups (ticks + timer callbacks),
+//                     frames, dirty pixels, persist writes, string formats
+//  --check DIR compares them with the golden copies in DIR.
+//  Built with TRACE_LEVEL above 0 (see trace.h), --trace FILE saves the
+//  trace ring the face persisted on exit, for tools/decode_trace.py --raw.
+//
+//  usage: countdown-replay [--clock local|utc] [--tz ZONE] [--out DIR]
+//                          [--check DIR] [--trace FILE]
+
+#define main countdown_main
+#include "../src/countdown.c"
+#undef main
+// only the face's own formatting counts
+#undef strftime
+#undef snprintf
+
+// 2015-05-01 .. 2018-01-01 UTC
+#define REPLAY_FROM 1430438400
+#define REPLAY_TO   1514764800
+#define REPLAY_TZ   "America/New_York"
+
+typedef enum {
+  step_disable,
+  step_enable,
+  step_battery,
+  step_bluetooth,
+  step_tap,
+} StepKind;
+
+typedef struct {
+  int      year, month, day, hour;
+  StepKind kind;
+  // setting key, charge percent or connected
+  int      arg;
+} ScenarioStep;
+
+// times are UTC
+static const ScenarioStep scenario[] = {
+  { 2015,  6, 10, 16, step_disable,   setting_MOT   },
+  { 2015,  7,  1, 16, step_disable,   setting_MME   },
+  { 2015,  7,  2, 13, step_enable,    setting_MOT   },
+  { 2015,  8,  1,  0, step_battery,   15            },
+  { 2015,  8,  3, 14, step_tap,       0             },
+  { 2015,  8,  8,  0, step_battery,   70            },
+  { 2015,  9,  1, 12, step_bluetooth, false         },
+  { 2015,  9,  3, 12, step_bluetooth, true          },
+  { 2015, 10,  5, 16, step_disable,   setting_MSSD  },
+  { 2015, 10,  8, 16, step_enable,    setting_MSSD  },
+  { 2016,  4,  1, 16, step_disable,   setting_MOTD  },
+  { 2016,  4,  2, 16, step_enable,    setting_MOTD  },
+};
+
+static const char *step_names[] = {
+  [step_disable]   = "disable",
+  [step_enable]    = "enable",
+  [step_battery]   = "battery",
+  [step_bluetooth] = "bluetooth",
+  [step_tap]       = "tap",
+};
+
+// ---------------------------------------------------------------------------
+// the watch clock, and the phone's UTC offset, worked out once per hour up
+// front
+
+static const char *zone = REPLAY_TZ;
+// SDK3: time() is UTC and localtime() knows the zone
+static bool utc_clock = false;
+
+typedef struct {
+  time_t utc;
+  long   offset;
+} ZoneChange;
+
+static ZoneChange zone_changes[64];
+static unsigned int n_zone_changes = 0;
+
+static void load_zone(void)
+{
+  setenv("TZ", zone, 1);
+  tzset();
+  long last = 0x7FFFFFFF;
+  for (time_t u = REPLAY_FROM; u < REPLAY_TO; u += 60*60) {
+    struct tm tm;
+    localtime_r(&u, &tm);
+    if (tm.tm_gmtoff != last && n_zone_changes < ARRAY_LENGTH(zone_changes)) {
+      zone_changes[n_zone_changes++] = (ZoneChange){ u, tm.tm_gmtoff };
+      last = tm.tm_gmtoff;
+    }
+  }
+  if (utc_clock) return;
+  // an SDK2 watch itself has no time zone
+  setenv("TZ", "UTC", 1);
+  tzset();
+}
+
+static long zone_offset(time_t utc)
+{
+  if (utc_clock) return 0;
+  long offset = 0;
+  for (unsigned int i = 0; i < n_zone_changes && zone_changes[i].utc <= utc; ++i)
+    offset = zone_changes[i].offset;
+  return offset;
+}
+
+// ---------------------------------------------------------------------------
+// output
+
+static FILE *transitions;
+static FILE *budget;
+
+static void format_time(char *buffer, size_t size, time_t watch)
+{
+  struct tm tm;
+  localtime_r(&watch, &tm);
+  strftime(buffer, size, "%Y-%m-%d %H:%M:%S", &tm);
+}
+
+static void log_countdown(time_t watch)
+{
+  static char logged[sizeof(countdown_buffer)];
+  if (strcmp(logged, countdown_buffer) == 0) return;
+  strcpy(logged, countdown_buffer);
+
+  char when[32], text[sizeof(countdown_buffer)];
+  format_time(when, sizeof(when), watch);
+  strcpy(text, countdown_buffer);
+  for (char *c = text; *c; ++c) {
+    if (*c == '\n') *c = '|';
+  }
+  fprintf(transitions, "%s  %s\n", when, text);
+}
+
+typedef struct {
+  int      yday;
+  int      year;
+  uint64_t dirty_pixels;
+} BudgetDay;
+
+static void write_budget(const BudgetDay *day, time_t watch)
+{
+  char when[32];
+  format_time(when, sizeof(when), watch);
+  when[10] = '\0';
+  fprintf(budget, "%s %8lu %8lu %8lu %8lu %10llu %8lu %8lu\n", when,
+          (unsigned long)(stub_counters.ticks + stub_counters.timers_fired),
+          (unsigned long)stub_counters.ticks, (unsigned long)stub_counters.timers_fired,
+          (unsigned long)stub_counters.frames, (unsigned long long)day->dirty_pixels,
+          (unsigned long)stub_counters.persist_writes, (unsigned long)stub_counters.formats);
+}
+
+// ---------------------------------------------------------------------------
+// scenario
+
+static void apply_step(const ScenarioStep *step, time_t watch)
+{
+  char when[32];
+  format_time(when, sizeof(when), watch);
+  fprintf(transitions, "%s  # %s %d\n", when, step_names[step->kind], step->arg);
+
+  switch (step->kind) {
+  case step_disable:
+  case step_enable: {
+    uint8_t packed[1+SETTINGS_MASK_BYTES];
+    pack_settings(packed);
+    unsigned int bit = step->arg - 1;
+    if (step->kind == step_enable)
+      packed[1+bit/8] |= 1 << (bit%8);
+    else
+      packed[1+bit/8] &= ~(1 << (bit%8));
+    stub_app_sync_receive_bytes(SETTINGS_PACKED_KEY, packed, sizeof(packed));
+    break;
+  }
+  case step_battery:
+    stub_battery_event((BatteryChargeState){ step->arg, false, false });
+    break;
+  case step_bluetooth:
+    stub_bluetooth_event(step->arg);
+    break;
+  case step_tap:
+    stub_tap_event();
+    break;
+  }
+}
+
+static TimeUnits units_between(const struct tm *a, const struct tm *b)
+{
+  TimeUnits units = 0;
+  if (a->tm_sec != b->tm_sec) units |= SECOND_UNIT;
+  if (a->tm_min != b->tm_min) units |= MINUTE_UNIT;
+  if (a->tm_hour != b->tm_hour) units |= HOUR_UNIT;
+  if (a->tm_mday != b->tm_mday || a->tm_mon != b->tm_mon || a->tm_year != b->tm_year) units |= DAY_UNIT;
+  if (a->tm_mon != b->tm_mon || a->tm_year != b->tm_year) units |= MONTH_UNIT;
+  if (a->tm_year != b->tm_year) units |= YEAR_UNIT;
+  return units;
+}
+
+static void replay(void)
+{
+  time_t at[ARRAY_LENGTH(scenario)];
+  for (unsigned int i = 0; i < ARRAY_LENGTH(scenario); ++i) {
+    struct tm tm = { 0 };
+    tm.tm_year = scenario[i].year - 1900;
+    tm.tm_mon  = scenario[i].month - 1;
+    tm.tm_mday = scenario[i].day;
+    tm.tm_hour = scenario[i].hour;
+    at[i] = timegm(&tm);
+  }
+  unsigned int next_step = 0;
+
+  time_t utc = REPLAY_FROM;
+  time_t watch = utc + zone_offset(utc);
+  struct tm last_tm;
+  localtime_r(&watch, &last_tm);
+
+  stub_persist_clear();
+  stub_set_time(watch);
+  stub_set_uptime_ms(0);
+  handle_init();
+  stub_render();
+  log_countdown(watch);
+
+  BudgetDay day = { last_tm.tm_yday, last_tm.tm_year, 0 };
+  time_t day_time = watch;
+  stub_reset_counters();
+
+  while (utc < REPLAY_TO) {
+    // the next tick the face is subscribed to
+    time_t next_tick = utc + ((stub_tick_units & SECOND_UNIT) ? 1 : 60 - last_tm.tm_sec);
+    // or a timer before it
+    uint64_t due_ms;
+    bool timer_only = false;
+    if (stub_next_timer_ms(&due_ms)) {
+      time_t due = REPLAY_FROM + (time_t)((due_ms + 999) / 1000);
+      if (due < next_tick) {
+        next_tick = (due > utc) ? due : utc + 1;
+        timer_only = true;
+      }
+    }
+    utc = next_tick;
+    watch = utc + zone_offset(utc);
+
+    struct tm tm;
+    localtime_r(&watch, &tm);
+    if (tm.tm_yday != day.yday || tm.tm_year != day.year) {
+      write_budget(&day, day_time);
+      stub_reset_counters();
+      day = (BudgetDay){ tm.tm_yday, tm.tm_year, 0 };
+      day_time = watch;
+    }
+
+    stub_set_time(watch);
+    stub_set_uptime_ms((uint64_t)(utc - REPLAY_FROM) * 1000);
+    while (next_step < ARRAY_LENGTH(scenario) && at[next_step] <= utc) {
+      apply_step(&scenario[next_step++], watch);
+    }
+    stub_run_timers();
+    if (!timer_only) {
+      stub_tick(&tm, units_between(&last_tm, &tm));
+      last_tm = tm;
+    }
+
+    day.dirty_pixels += face_dirty.size.w * face_dirty.size.h;
+    stub_render();
+    log_countdown(watch);
+  }
+  write_budget(&day, day_time);
+
+  handle_deinit();
+}
+
+// the ring as handle_deinit() left it in persist
+static void save_trace(const char *path)
+{
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+  TraceRing ring;
+  int read = persist_read_data(TRACE_KEY, &ring, sizeof(ring));
+  FILE *f = fopen(path, "wb");
+  if (!f || read != (int)sizeof(ring) || fwrite(&ring, sizeof(ring), 1, f) != 1) {
+    perror(path);
+    exit(2);
+  }
+  fclose(f);
+#else
+  fprintf(stderr, "%s: built without TRACE_LEVEL, no trace\n", path);
+#endif
+}
+
+// ---------------------------------------------------------------------------
+
+static FILE *open_output(const char *dir, const char *name)
+{
+  char path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  FILE *f = fopen(path, "w");
+  if (!f) {
+    perror(path);
+    exit(2);
+  }
+  return f;
+}
+
+// first differing line, or 0 if the files match
+static int compare_files(const char *dir, const char *golden_dir, const char *name)
+{
+  char path[256], golden_path[256];
+  snprintf(path, sizeof(path), "%s/%s", dir, name);
+  snprintf(golden_path, sizeof(golden_path), "%s/%s", golden_dir, name);
+  FILE *f = fopen(path, "r");
+  FILE *g = fopen(golden_path, "r");
+  if (!f || !g) {
+    fprintf(stderr, "cannot compare %s with %s\n", path, golden_path);
+    return -1;
+  }
+
+  char line[256], golden_line[256];
+  int n = 0, diff = 0;
+  while (!diff) {
+    ++n;
+    char *a = fgets(line, sizeof(line), f);
+    char *b = fgets(golden_line, sizeof(golden_line), g);
+    if (!a && !b) break;
+    if (!a || !b || strcmp(a, b) != 0) {
+      diff = n;
+      fprintf(stderr, "%s:%d differs from %s\n  got:    %s  wanted: %s", path, n, golden_path,
+              a ? a : "(end of file)\n", b ? b : "(end of file)\n");
+    }
+  }
+  fclose(f);
+  fclose(g);
+  return diff;
+}
+
+int main(int argc, char **argv)
+{
+  const char *out_dir = ".";
+  const char *golden_dir = NULL;
+  const char *trace_path = NULL;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    if (strcmp(argv[i], "--out") == 0)
+      out_dir = argv[i+1];
+    else if (strcmp(argv[i], "--check") == 0)
+      golden_dir = argv[i+1];
+    else if (strcmp(argv[i], "--trace") == 0)
+      trace_path = argv[i+1];
+    else if (strcmp(argv[i], "--tz") == 0)
+      zone = argv[i+1];
+    else if (strcmp(argv[i], "--clock") == 0)
+      utc_clock = strcmp(argv[i+1], "utc") == 0;
+  }
+
+  load_zone();
+  transitions = open_output(out_dir, "transitions.txt");
+  budget = open_output(out_dir, "budget.txt");
+  fprintf(budget, "%-10s %8s %8s %8s %8s %10s %8s %8s\n", "day", "wakeups", "ticks", "timers",
+          "frames", "dirty_px", "p_write", "formats");
+
+  replay();
+  fclose(transitions);
+  fclose(budget);
+  if (trace_path) save_trace(trace_path);
+
+  if (!golden_dir) return 0;
+  int failed = compare_files(out_dir, golden_dir, "transitions.txt") != 0;
+  failed |= compare_files(out_dir, golden_dir, "budget.txt") != 0;
+  if (!failed) printf("replay matches %s\n", golden_dir);
+  return failed;
+}
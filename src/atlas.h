@@ -0,0 +1,19 @@
+#pragma once
+
+// Sprite rectangles in the INDICATOR_ATLAS resource.
+// Generated by tools/make_atlas.py, do not edit.
+
+#define ATLAS_AMPM_PM            GRect( 0,  0, 23, 25)
+#define ATLAS_AMPM_AM            GRect(23,  0, 23, 25)
+#define ATLAS_AMPM_BLANK         GRect(46,  0, 23, 25)
+#define ATLAS_BT_DISCONNECTED    GRect(66, 35, 18, 10)
+#define ATLAS_BT_CONNECTED       GRect( 0, 45, 18, 10)
+#define ATLAS_BATTERY_BASIC      GRect(69,  0, 22, 10)
+#define ATLAS_BATTERY_CHARGING   GRect(69, 10, 22, 10)
+#define ATLAS_BATTERY_CONNECTED  GRect( 0, 25, 22, 10)
+#define ATLAS_BATTERY_100        GRect(22, 25, 22, 10)
+#define ATLAS_BATTERY_80         GRect(44, 25, 22, 10)
+#define ATLAS_BATTERY_60         GRect(66, 25, 22, 10)
+#define ATLAS_BATTERY_40         GRect( 0, 35, 22, 10)
+#define ATLAS_BATTERY_20         GRect(22, 35, 22, 10)
+#define ATLAS_BATTERY_EMPTY      GRect(44, 35, 22, 10)
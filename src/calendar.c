@@ -0,0 +1,78 @@
+#include <pebble.h>
+#include "calendar.h"
+
+#define SECONDS_PER_DAY (60*60*24)
+#define TIME_MAX        ((time_t)0x7FFFFFFF)
+
+static time_t  today         = 0;
+static time_t  tomorrow      = 0;
+static int32_t today_day     = 0;
+// local time - UTC, 0 where time() is already local
+static int32_t utc_offset    = 0;
+static bool    offset_changed = false;
+
+// rounds towards minus infinity, unlike /
+static int32_t floor_div(int32_t a, int32_t b)
+{
+  int32_t q = a / b;
+  return (a % b < 0) ? q - 1 : q;
+}
+
+bool calendar_update(time_t now)
+{
+  if ((tomorrow != 0) && (now >= today) && (now < tomorrow)) return false;
+
+  struct tm *local = localtime(&now);
+  int32_t since_midnight = local->tm_hour*60*60 + local->tm_min*60 + local->tm_sec;
+  today = now - since_midnight;
+
+  // whatever separates the local clock from time(), to the nearest minute
+  int32_t offset = since_midnight - (int32_t)(now - floor_div(now, SECONDS_PER_DAY)*SECONDS_PER_DAY);
+  offset = floor_div(offset + 30, 60) * 60;
+  if (offset > 14*60*60) offset -= SECONDS_PER_DAY;
+  if (offset < -12*60*60) offset += SECONDS_PER_DAY;
+  // the first update has nothing to compare with
+  offset_changed = (tomorrow != 0) && (offset != utc_offset);
+  utc_offset = offset;
+
+  today_day = floor_div(today + utc_offset, SECONDS_PER_DAY);
+  // where time() is UTC a DST change today moves tomorrow's midnight by
+  // the change; where it is local the clock jumps instead, and
+  // calendar_update corrects tomorrow when we get there
+  tomorrow = today + SECONDS_PER_DAY;
+  local = localtime(&tomorrow);
+  int32_t past = local->tm_hour*60*60 + local->tm_min*60 + local->tm_sec;
+  tomorrow += (past < SECONDS_PER_DAY/2) ? -past : SECONDS_PER_DAY - past;
+  return true;
+}
+
+bool calendar_offset_changed()
+{
+  return offset_changed;
+}
+
+int32_t calendar_utc_offset()
+{
+  return utc_offset;
+}
+
+time_t calendar_today()
+{
+  return today;
+}
+
+time_t calendar_tomorrow()
+{
+  return tomorrow;
+}
+
+time_t calendar_midnight(int32_t day)
+{
+  if (day >= CALENDAR_LAST_DAY) return TIME_MAX;
+  return day*SECONDS_PER_DAY - utc_offset;
+}
+
+int32_t calendar_days_until(int32_t day)
+{
+  return day - today_day;
+}
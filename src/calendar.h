@@ -0,0 +1,36 @@
+#pragma once
+
+#include <pebble.h>
+
+// Calendar days
+//
+// Day counts for the countdown are whole local calendar days, worked out
+// with integer maths from a cached local midnight.  The cache (today's
+// midnight, tomorrow's and the UTC offset) is only recomputed, with one
+// localtime(), when calendar_update() sees the day change.
+//
+// Days are numbered from 1970-01-01 local time, like the event days in
+// the catalog (see catalog.h).  Today's number comes from localtime(), so
+// it is the same whether time() keeps local time (SDK2) or UTC (SDK3).
+// Local midnights are worked out with today's UTC offset; when DST moves
+// it, calendar_offset_changed() says so and the face works them out again.
+
+// first day too late to have a time_t midnight
+#define CALENDAR_LAST_DAY 24855
+
+// refresh the cache if now is outside today; true if it changed.  This
+// uses localtime(), so call it before taking a struct tm from there
+bool    calendar_update(time_t now);
+// true if the UTC offset changed at the last update, e.g. for DST
+bool    calendar_offset_changed(void);
+// local time - UTC, in seconds
+int32_t calendar_utc_offset(void);
+
+// local midnight starting today and tomorrow
+time_t  calendar_today(void);
+time_t  calendar_tomorrow(void);
+
+// local midnight starting day, clamped to the largest time_t
+time_t  calendar_midnight(int32_t day);
+// whole days from today to day
+int32_t calendar_days_until(int32_t day);
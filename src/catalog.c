@@ -0,0 +1,60 @@
+#include <pebble.h>
+#include "catalog.h"
+#include "stream.h"
+
+static ResHandle     handle;
+static CatalogHeader header;
+
+#define RECORDS_OFFSET sizeof(CatalogHeader)
+#define NAMES_OFFSET   (RECORDS_OFFSET + header.count*sizeof(CatalogRecord))
+
+bool catalog_init()
+{
+  stream_init();
+  handle = resource_get_handle(RESOURCE_ID_EVENT_CATALOG);
+  size_t got = resource_load_byte_range(handle, 0, (uint8_t *)&header, sizeof(header));
+
+  if ((got != sizeof(header)) || (memcmp(header.magic, "MEVC", 4) != 0) ||
+      (header.format != CATALOG_FORMAT_VERSION) ||
+      (resource_size(handle) < NAMES_OFFSET + header.names_size)) {
+    APP_LOG(APP_LOG_LEVEL_ERROR, "Bad event catalog");
+    memset(&header, 0, sizeof(header));
+    return false;
+  }
+  return true;
+}
+
+uint16_t catalog_count()
+{
+  if (stream_active()) return stream_count();
+  return header.count;
+}
+
+uint32_t catalog_version()
+{
+  if (stream_active()) return stream_version();
+  return header.version;
+}
+
+bool catalog_read(uint16_t index, CatalogRecord *record)
+{
+  if (stream_active()) return stream_read(index, record);
+  if (index >= header.count) return false;
+  return resource_load_byte_range(handle, RECORDS_OFFSET + index*sizeof(CatalogRecord),
+                                  (uint8_t *)record, sizeof(*record)) == sizeof(*record);
+}
+
+void catalog_read_name(const CatalogRecord *record, char *buffer, size_t size)
+{
+  if (stream_active()) {
+    stream_read_name(record, buffer, size);
+    return;
+  }
+  size_t got = 0;
+  if (record->name < header.names_size) {
+    size_t want = header.names_size - record->name;
+    if (want > size-1) want = size-1;
+    got = resource_load_byte_range(handle, NAMES_OFFSET + record->name, (uint8_t *)buffer, want);
+  }
+  buffer[got] = '\0';
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include <pebble.h>
+
+// Event catalog
+//
+// The schedule lives in the EVENT_CATALOG raw resource built by
+// tools/make_catalog.py from resources/data/events.json, not in RAM.
+// Records are fixed width and sorted by first day, so any one of them can
+// be read with a single resource_load_byte_range; names sit in a shared
+// table after the records.  Days are local calendar dates, counted from
+// 1970-01-01, so an event starts at local midnight wherever the watch is
+// (see calendar.h).
+//
+// Once the companion has streamed events to the watch they stand in for
+// the resource, see stream.h; the calls below read whichever is in use.
+
+#define CATALOG_FORMAT_VERSION 2
+
+typedef struct __attribute__((__packed__)) {
+  char     magic[4];
+  uint16_t format;
+  uint16_t count;
+  // changes whenever the schedule does
+  uint32_t version;
+  uint16_t names_size;
+  uint16_t reserved;
+} CatalogHeader;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t day;
+  uint8_t  id;
+  // days in the event, counting first and last
+  uint8_t  length;
+  uint16_t name;
+} CatalogRecord;
+
+// also reads back what was streamed
+bool     catalog_init(void);
+
+uint16_t catalog_count(void);
+uint32_t catalog_version(void);
+
+bool     catalog_read(uint16_t index, CatalogRecord *record);
+// copies the record's name, always NUL terminated
+void     catalog_read_name(const CatalogRecord *record, char *buffer, size_t size);
@@ -1,190 +1,163 @@
 #include <pebble.h>
+#include "atlas.h"
+#include "calendar.h"
+#include "catalog.h"
+#include "face_state.h"
+#include "glyphs.h"
+#include "layout.h"
+#include "outbox.h"
+#include "refresh.h"
+#include "settings.h"
+#include "settings_schema.h"
+#include "stats.h"
+#include "stream.h"
+#include "trace.h"
 
 // defines
 #define USE_SET_PEBBLE 1
 
-#define STORAGE_KEY_OFFSET 64
+// refresh policy: drop to one tick a minute at or below this battery level,
+// or while the phone is disconnected; a wrist tap brings seconds back
+#define REFRESH_LOW_BATTERY       20
+#define REFRESH_SLOW_DISCONNECTED true
+#define REFRESH_TAP_WAKE_SECONDS  30
+// 0: the seconds keep going while the watch lies still
+#define REFRESH_IDLE_MINUTES      0
 
 // constants
-enum Settings { setting_MOTD = 1, setting_AMVIV, setting_MOT,   setting_MME,
-                setting_MACK,     setting_MITM,  setting_MandM, setting_MiF,
-                setting_MSSD,     setting_MITO                               };
-
-static Window    *window;
-static TextLayer *hours_layer;
-static TextLayer *minutes_layer;
-static TextLayer *seconds_layer;
-static TextLayer *countdown_layer;
+// enum Settings, setting_event_id[] and SETTINGS_TUPLETS come from the
+// "setting" keys in resources/data/events.json, see settings_schema.h
+
+// Packed settings tuple sent by pebble-js-app.js: a byte array holding
+// the schema version, then one bit per setting key (bit 0 is key 1),
+// least significant byte first.  The per-key tuples above are still
+// accepted from older companions.
+#define SETTINGS_PACKED_KEY  100
+#define SETTINGS_SCHEMA      1
+#define SETTINGS_MASK_BYTES  ((setting_count-1+7)/8)
+
+// Watch -> phone: ACTION_KEY ("action" in appinfo.json) says what we
+// want, with the packed settings and the stream cursor we have.
+// ACTION_SETTINGS asks the companion to send any settings we are
+// missing, ACTION_EVENTS for the next chunk of events (see stream.h).
+#define ACTION_KEY           101
+#define ACTION_SETTINGS      1
+#define ACTION_EVENTS        2
+
+// Streamed events: our StreamCursor out, a chunk of events in
+#define STREAM_CURSOR_KEY    102
+#define STREAM_CHUNK_KEY     103
+
+// AppMessage buffers sized for the biggest dictionary each way rather
+// than the maximum: a count byte, then each tuple's key, type and length
+// ahead of its value.  In comes every per-key tuple plus the packed one,
+// or a chunk of events; out goes an action.  AppSync keeps the last of
+// each, so its buffer holds both.  PebbleKit JS sends the per-key settings
+// as int32s, whatever the value.
+#define DICT_TUPLE_SIZE(value_bytes) (sizeof(Tuple) + (value_bytes))
+#define SETTINGS_INBOX_SIZE  (1 + (setting_count-1) * DICT_TUPLE_SIZE(sizeof(int32_t)) + \
+                              DICT_TUPLE_SIZE(1+SETTINGS_MASK_BYTES))
+#define STREAM_INBOX_SIZE    (1 + DICT_TUPLE_SIZE(STREAM_CHUNK_SIZE))
+#define INBOX_SIZE           ((SETTINGS_INBOX_SIZE > STREAM_INBOX_SIZE) ? SETTINGS_INBOX_SIZE : STREAM_INBOX_SIZE)
+#define SYNC_BUFFER_SIZE     (SETTINGS_INBOX_SIZE + DICT_TUPLE_SIZE(STREAM_CHUNK_SIZE))
+#define ACTION_OUTBOX_SIZE   (1 + DICT_TUPLE_SIZE(1) + DICT_TUPLE_SIZE(1+SETTINGS_MASK_BYTES) + \
+                              DICT_TUPLE_SIZE(sizeof(StreamCursor)))
+
+// stages 2 and 3 of startup follow the first frame, or come this long
+// after handle_init if there is none
+#define STARTUP_STAGE_MS 500
+
+// AppSync delivers a whole dictionary as one callback per tuple; wait
+// this long after the last one before choosing the event again
+#define SYNC_SETTLE_MS 250
+
+// the face layout and fonts for each platform are in layout.h
+
+static Window *window;
+// the whole face is drawn by this one layer, see face_update_proc()
+static Layer  *face_layer;
+static GFont   time_font;
+static GFont   seconds_font;
+static GFont   countdown_font;
+// hours/minutes and seconds are blitted from these once they are rendered
+static GlyphCache time_glyphs;
+static GlyphCache seconds_glyphs;
+#if STATS_ENABLED
+static GFont   stats_font;
+#endif
 
 #if USE_SET_PEBBLE
-// for http://setpebble.com settings
+// settings from the companion's configuration page
 static AppSync app;
 
-static uint8_t buffer[256];
-
-typedef enum {
-  event_off = 0,
-  event_on,
-  event_count
-} EventSetting;
-
-//static enum SettingMOTD  { motd_off  = 0, motd_on,  motd_count  } motd;
-static EventSetting motd;
-static EventSetting amviv;
-static EventSetting mot;
-static EventSetting mme;
-static EventSetting mack;
-static EventSetting mitm;
-static EventSetting mandm;
-static EventSetting mif;
-static EventSetting mssd;
-static EventSetting mito;
+// AppSync keeps the whole dictionary
+static uint8_t buffer[SYNC_BUFFER_SIZE];
 #endif
 
 // Create long-lived buffers
-static char hours_buffer[]   = "00:";
-static char minutes_buffer[] = "00";
-static char seconds_buffer[] = ":00";
+// These hold what is on screen right now; they start empty so the
+// first frame always differs from them
+static char hours_buffer[sizeof("00:")];
+static char minutes_buffer[sizeof("00")];
+static char seconds_buffer[sizeof(":00")];
 
 static char to_go_buffer[] = "  NOW days";
 static char countdown_buffer[256];
 
+// how many times each part of the face has actually changed
+static struct {
+  uint32_t hours;
+  uint32_t minutes;
+  uint32_t seconds;
+  uint32_t countdown;
+  uint32_t ampm;
+  uint32_t battery;
+  uint32_t bt;
+} redraws;
+
 static unsigned int event_index = 0;
 
-typedef struct {
-  uint8_t id;
-  bool    enabled;
-  uint8_t length;
-  time_t  start;
-  char   *name;
-} event_data;
-
-static event_data event[] = {
-  // Timestamp should be 00:00 on the first day
-  // Get the timestamp from http://www.epochconverter.com/
-  // Length is the number of days in the event, counting first and last
-  
-  // Don't change the ID of any event.  Add new one events in time order
-  // to the list, and pick the next ID available so that the
-  // persistent storage data will be retained from other releases
-  // Each event must occur only ONCE on the list, so don't try
-  // to add next year's event as well as this year's, bad things
-  // will probably happen.  Just keep the ID, change the timestamp,
-  // and move it to the right point in the list.
-  // If an event goes away for a year, just set the timestamp to
-  // either 0 and move it to the front, don't delete it
-  // If an event really goes away then set the timestamp to 0x7FFFFFFF
-  // and move it to the end of the list AFTER the "MINI" event.
-
-  // bogus event so there's always one before the real events
-  {  0,true, 0, 0,          "DUMMY"},
-
-  // start timestamp for A MINI Vacation in Vegas 5/28
-  {  2,true, 4, 1432785600, "AMVIV"},   
-  // start timestamp for MINIs on Top 6/19
-  {  3,true, 2, 1434686400, "MOT"  },
-  // start timestamp for MINI Meet East 6/29
-  {  4,true, 3, 1435550400, "MME"  },
-  // start timestamp for MINIs on the Mack 7/31
-  {  5,true, 2, 1438315200, "MACK" },
-  // start timestamp for MINIs in the Mountains 8/5
-  {  6,true, 5, 1438747200, "MITM" },
-  // start timestamp for Mickey and MINI 9/25
-  {  7,true, 3, 1443153600, "MandM"},
-  // start timestamp for MINIs in Foliage 10/1
-  {  8,true, 4, 1443672000, "MiF"  },
-  // start timestamp for MINIs Slay the Sleeping Dragon 10/9
-  {  9,true, 3, 1444363200, "MSSD" },
-  // start timestamp for MINIS in the Ozarks 10/22
-  { 10,true, 4, 1445486400, "MITO" },
-  // start timestamp for MINIs on the Dragon 5/12/2016
-  {  1,true, 5, 1463025600, "MOTD" },
-
-  // bogus event so there's always one after the real events
-  {255,true, 0, 0x7FFFFFFE, "MINI" }
-};
-
-static unsigned int n_events = sizeof(event)/sizeof(event[0]);
-
-static int id_to_index(uint8_t id)
-{
-  int index = -1;
-  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Looking for id %d", id);
-  if (id<255) {
-    for (uint8_t i = 0; i < n_events; ++i) {
-      if (event[i].id == id) {
-        index = i;
-        //APP_LOG(APP_LOG_LEVEL_DEBUG, "Found  id %d at index %d", id, i);
-        break;
-      }
-    }
-  }
-  return index;
-}
+// The events themselves live in the EVENT_CATALOG resource, see
+// catalog.h and resources/data/events.json, or once the companion streams
+// them in a ring of the next few, see stream.h.  Index 0 is the bogus
+// event before the real ones and the "MINI" event (id 255) comes after
+// them.  Whether each one is enabled is kept by id in the settings store.
 
-static uint8_t index_to_id(uint8_t index)
-{
-  int id = 255;
-  if (index < n_events) id = event[index].id;
-  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Index %d is id %d", index, id);
-  return id;
-}
+#define TIME_FOREVER ((time_t)0x7FFFFFFF)
+#define DAY_FOREVER  ((int32_t)0x7FFFFFFF)
 
-static bool recall_setting(uint8_t id, bool* enable)
+// Events run for whole local days, see calendar.h
+// local midnight the event starts on
+static time_t event_on_at(const CatalogRecord *record)
 {
-  bool found = false;
-  uint32_t storage_key =  STORAGE_KEY_OFFSET + (uint32_t)id;
-  if (persist_exists(storage_key)) {
-    *enable = persist_read_bool(storage_key);
-	  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Found setting %lu for id %d value %d", storage_key, id, *enable);
-    found = true;
-  }
-  return (found);
+  return calendar_midnight(record->day);
 }
 
-static void recall_all_settings()
+// local midnight after the last day of the event
+static time_t event_over_at(const CatalogRecord *record)
 {
-  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Recalling all settings");
-  uint8_t  id = 255;
-  for (uint8_t i = 1; i < n_events; ++i) {
-    id = index_to_id(i);
-    bool enable;
-    if (recall_setting(id, &enable)) event[i].enabled = enable;
-  }  
+  return calendar_midnight(record->day + record->length);
 }
 
-static void store_setting(uint8_t id, bool enable)
+// the day after the last day of the event
+static time_t event_finish(const CatalogRecord *record)
 {
-  bool enabled;
-  bool exists = recall_setting(id, &enabled);
-  if ((exists && enable!=enabled) || !exists) {
-    uint32_t storage_key = STORAGE_KEY_OFFSET + (uint32_t)id;
-    persist_write_bool(storage_key,enable);
-	  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Stored setting %lu for id %d value %d", storage_key, id, enable);
-  }
+  return calendar_midnight(record->day + record->length + 1);
 }
 
-static void store_all_settings()
-{
-  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Storing all settings");
-  uint8_t id = 255;
-  for (uint8_t i = 1; i < n_events; ++i) {
-    id = index_to_id(i);
-    store_setting(id, event[i].enabled);
-  }   
-}
-
-// start timestamp
-static time_t event_start = 0;
+// first day, see catalog.h
+static int32_t event_day = 0;
 // number of days - 1 (starts at 0)
-static int    event_length = 0;
+static int     event_length = 0;
 // name of the event
-static char   event_name_buffer[32];
+static char    event_name_buffer[32];
 
-static BitmapLayer *s_background_layer;
 static GBitmap *s_background_bitmap;
+// the part of the background behind the seconds
+static GBitmap *seconds_background;
 
-static BitmapLayer *battery_layer;
+// all the indicator sprites below are cut out of this one bitmap
+static GBitmap *indicator_atlas;
 
 static GBitmap *battery_basic;
 static GBitmap *battery_20;
@@ -196,367 +169,813 @@ static GBitmap *battery_charging;
 static GBitmap *battery_empty;
 static GBitmap *battery_connected;
 
-static BitmapLayer *bt_layer;
 static GBitmap *bt_connected;
 static GBitmap *bt_disconnected;
 
-static BitmapLayer *ampm_layer;
 static GBitmap *ampm_blank;
 static GBitmap *ampm_am;
 static GBitmap *ampm_pm;
 
-void choose_event()
+// bitmaps currently shown by the indicators
+static const GBitmap *battery_shown;
+static const GBitmap *bt_shown;
+static const GBitmap *ampm_shown;
+static bool           seconds_shown = true;
+
+// Part of the face that changed since it was last drawn.  The window has
+// a clear background, so the frame buffer keeps the last frame and a
+// change that stays within SECONDS_RECT only repaints that corner.
+static GRect face_dirty;
+
+static bool grect_within(GRect inner, GRect outer)
 {
-  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Choosing event");
-  // pick event based on current time
-  // Algorithm:
-  //   start at the second entry in the structure.
-  //   If the event is enabled through the settings
-  //     If the current time is:
-  //       greater than the end time of the previous event+1 day
-  //       *and*
-  //       it's less than the start time of the next event
-  //     then this is the event we care about
-  //     so set event_index to this one and break out of the loop.
-
-  // get time now
-  time_t temp = time(NULL); 
-
-  // initialize variable
-  time_t last_finish = event[0].start + (event[0].length+1)*60*60*24;
-  
-  for (unsigned int i=1; i<n_events; ++i) {
-    if (event[i].enabled) {
-      time_t this_finish = event[i].start + (event[i].length+1)*60*60*24;
-
-      event_index = i;
-      if ((temp > last_finish) && (temp < this_finish)) {
-        // time now is after the end of the last event
-        // and before the end of the current event
-        break;
-      }
-      last_finish = this_finish;
+  return (inner.origin.x >= outer.origin.x) && (inner.origin.y >= outer.origin.y) &&
+         (inner.origin.x + inner.size.w <= outer.origin.x + outer.size.w) &&
+         (inner.origin.y + inner.size.h <= outer.origin.y + outer.size.h);
+}
+
+static void mark_dirty(GRect area)
+{
+  if ((face_dirty.size.w == 0) || (face_dirty.size.h == 0)) {
+    face_dirty = area;
+  } else {
+    int16_t x0 = (area.origin.x < face_dirty.origin.x) ? area.origin.x : face_dirty.origin.x;
+    int16_t y0 = (area.origin.y < face_dirty.origin.y) ? area.origin.y : face_dirty.origin.y;
+    int16_t x1 = face_dirty.origin.x + face_dirty.size.w;
+    int16_t y1 = face_dirty.origin.y + face_dirty.size.h;
+    if (area.origin.x + area.size.w > x1) x1 = area.origin.x + area.size.w;
+    if (area.origin.y + area.size.h > y1) y1 = area.origin.y + area.size.h;
+    face_dirty = GRect(x0, y0, x1-x0, y1-y0);
+  }
+  if (face_layer) {
+    layer_mark_dirty(face_layer);
+    STATS_INC(stat_mark_dirty);
+  }
+}
+
+// Only mark the face dirty when the content differs from what it shows
+static void set_text_if_changed(GRect area, char *shown, const char *next, size_t size, uint32_t *count)
+{
+  if (strncmp(shown, next, size) == 0) return;
+  strncpy(shown, next, size);
+  mark_dirty(area);
+  ++*count;
+}
+
+static void set_bitmap_if_changed(GRect area, const GBitmap **shown, const GBitmap *next, uint32_t *count)
+{
+  if (*shown == next) return;
+  *shown = next;
+  mark_dirty(area);
+  ++*count;
+}
+
+// What the countdown says about the chosen event
+typedef enum {
+  state_counting = 0,
+  state_on,
+  state_over
+} EventState;
+
+static EventState event_state = state_counting;
+
+// Transition schedule
+// Every point in time where the countdown changes event or state, in
+// time order.  Each shown event owns the time from the end of the
+// previous shown event (its finish + 1 day) up to its own finish, and
+// contributes up to three entries:
+//   counting down -> is ON! (start) -> is over (start + length days)
+// The next shown event takes over at this event's finish.
+// The catalog can be long, so we only hold a window of the next few shown
+// events and build the next window when time runs past schedule_end.
+// Building it is also when streamed events that are over get dropped.
+// It also has to be rebuilt when an event is enabled or disabled; in
+// between lookups are a binary search.
+#define SCHEDULE_WINDOW 8
+
+typedef struct {
+  time_t   at;
+  uint16_t index;
+  uint8_t  state;
+} transition;
+
+static transition   schedule[3 * SCHEDULE_WINDOW];
+static unsigned int n_transitions = 0;
+// entry we are in right now
+static unsigned int schedule_pos  = 0;
+// the window is good until here
+static time_t       schedule_end  = 0;
+
+static void add_transition(time_t at, time_t not_before, uint16_t index, EventState state)
+{
+  // an event that overlaps the previous one starts where that one ends
+  if (at < not_before) at = not_before;
+  // a later entry at the same time replaces the earlier one
+  if ((n_transitions > 0) && (schedule[n_transitions-1].at == at)) --n_transitions;
+  schedule[n_transitions++] = (transition){ at, index, state };
+}
+
+// the first event not finished by now; finish times are in catalog
+// order (make_catalog.py checks), so binary search for it
+static uint16_t first_unfinished(time_t now, uint16_t count)
+{
+  CatalogRecord record;
+  uint16_t lo = 1, hi = count;
+  while (lo < hi) {
+    uint16_t mid = (lo + hi) / 2;
+    if (catalog_read(mid, &record) && event_finish(&record) <= now)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static void fill_schedule(time_t now)
+{
+  CatalogRecord record;
+  uint16_t count = catalog_count();
+
+  n_transitions = 0;
+  schedule_end  = TIME_FOREVER;
+  if (count == 0) return;
+
+  uint16_t lo = first_unfinished(now, count);
+  // streamed events that are over make room for the next ones
+  if (stream_drop(lo)) {
+    count = catalog_count();
+    lo = first_unfinished(now, count);
+  }
+  // once everything is over the last event stays
+  if (lo == count) lo = count-1;
+
+  // the shown event before it decides where its time begins
+  catalog_read(0, &record);
+  time_t last_finish = event_finish(&record);
+  for (uint16_t i = lo; i-- > 1; ) {
+    if (catalog_read(i, &record) && settings_enabled(record.id)) {
+      last_finish = event_finish(&record);
+      break;
     }
   }
-  event_start = event[event_index].start;
-  // account for including first day in the info structure by subtracting 1
-  event_length = event[event_index].length-1;
-  strncpy(event_name_buffer, event[event_index].name,sizeof(event_name_buffer));
+
+  unsigned int shown = 0;
+  for (uint16_t i = lo; (i < count) && (shown < SCHEDULE_WINDOW); ++i) {
+    if (catalog_read(i, &record) && settings_enabled(record.id)) {
+      add_transition(last_finish, last_finish, i, state_counting);
+      add_transition(event_on_at(&record), last_finish, i, state_on);
+      add_transition(event_over_at(&record), last_finish, i, state_over);
+      // nothing after the "MINI" event is ever shown
+      if (record.id == 255) return;
+      last_finish = event_finish(&record);
+      ++shown;
+    }
+  }
+  schedule_end = last_finish;
+}
+
+// Current settings, packed the way the companion sends them.  At startup
+// they come with the face state, so the settings store itself is only
+// read once something needs it.
+static uint8_t settings_packed[1+SETTINGS_MASK_BYTES];
+
+static void pack_settings(uint8_t *packed)
+{
+  memset(packed, 0, 1+SETTINGS_MASK_BYTES);
+  packed[0] = SETTINGS_SCHEMA;
+  for (unsigned int key = 1; key < setting_count; ++key) {
+    if (settings_enabled(setting_event_id[key])) packed[1+(key-1)/8] |= 1 << ((key-1)%8);
+  }
 }
 
-void update_seconds() {
-  // Get a tm structure
-  time_t temp = time(NULL); 
-  struct tm *tick_time = localtime(&temp);
+// Face state, see face_state.h
+_Static_assert(ARRAY_LENGTH(schedule) <= FACE_STATE_TRANSITIONS, "schedule does not fit FaceState");
+_Static_assert(sizeof(settings_packed) <= FACE_STATE_SETTINGS, "settings do not fit FaceState");
 
-  strftime(seconds_buffer, sizeof(":00"), ":%S", tick_time);
-  // Display this time on the TextLayer
-  text_layer_set_text(seconds_layer, seconds_buffer);
+// a new window is saved once choose_event knows where we are in it
+static bool face_state_dirty = false;
+
+static void save_face_state(void)
+{
+  FaceState state = {
+    .version         = FACE_STATE_VERSION,
+    .count           = n_transitions,
+    .catalog_version = catalog_version(),
+    .utc_offset      = calendar_utc_offset(),
+    .end             = schedule_end,
+  };
+  memcpy(state.settings, settings_packed, sizeof(settings_packed));
+  for (unsigned int i = 0; i < n_transitions; ++i)
+    state.transitions[i] = (FaceTransition){ schedule[i].at, schedule[i].index, schedule[i].state };
+
+  // the next start takes its settings from here without reading the store,
+  // so the store has to have them first
+  settings_flush();
+  STATS_INC(stat_persist_write);
+  if (persist_write_data(FACE_STATE_KEY, &state, sizeof(state)) == (int)sizeof(state))
+    face_state_dirty = false;
 }
 
-void update_minutes() {
-  // Get a tm structure
-  time_t temp = time(NULL); 
-  struct tm *tick_time = localtime(&temp);
+// the last schedule entry at or before now, or the first one if we are
+// before them all
+static unsigned int schedule_find(time_t now)
+{
+  unsigned int lo = 0, hi = n_transitions;
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+    if (schedule[mid].at <= now)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+  return (lo > 0) ? lo - 1 : 0;
+}
+
+// the schedule window and settings in one read; false if there is no
+// state we can use, e.g. on first run or with a new catalog
+static bool load_face_state(time_t now)
+{
+  FaceState state;
+  int read = persist_read_data(FACE_STATE_KEY, &state, sizeof(state));
+  STATS_INC(stat_persist_read);
+  if ((read != (int)sizeof(state)) || (state.version != FACE_STATE_VERSION) ||
+      (state.catalog_version != catalog_version()) ||
+      (state.utc_offset != calendar_utc_offset()) ||
+      (state.count == 0) || (state.count > ARRAY_LENGTH(schedule)) ||
+      (state.settings[0] != SETTINGS_SCHEMA))
+    return false;
+
+  memcpy(settings_packed, state.settings, sizeof(settings_packed));
+  n_transitions = state.count;
+  for (unsigned int i = 0; i < n_transitions; ++i)
+    schedule[i] = (transition){ state.transitions[i].at, state.transitions[i].index, state.transitions[i].state };
+  schedule_end = state.end;
+  schedule_pos = schedule_find(now);
+  return true;
+}
+
+static void build_schedule(time_t now)
+{
+  fill_schedule(now);
+  // an empty catalog is rebuilt every time anyway
+  if (n_transitions > 0) face_state_dirty = true;
+#if USE_SET_PEBBLE
+  // sent once startup gets to the outbox, if not already
+  if (stream_wants_more()) outbox_request(ACTION_EVENTS);
+#endif
+}
+
+void choose_event(time_t now)
+{
+  CatalogRecord record;
+
+  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Choosing event");
+  STATS_INC(stat_choose_event);
+  if ((n_transitions == 0) || (now < schedule[0].at) || (now >= schedule_end))
+    build_schedule(now);
+
+  if (n_transitions == 0) {
+    // no usable catalog
+    event_index = 0;
+    event_state = state_counting;
+    event_day = DAY_FOREVER;
+    event_length = 0;
+    event_name_buffer[0] = '\0';
+    return;
+  }
+
+  // pick event based on current time
+  schedule_pos = schedule_find(now);
+  if (face_state_dirty) save_face_state();
+
+  event_index = schedule[schedule_pos].index;
+  event_state = schedule[schedule_pos].state;
+  catalog_read(event_index, &record);
+  event_day = record.day;
+  // account for including first day in the info structure by subtracting 1
+  event_length = record.length-1;
+  catalog_read_name(&record, event_name_buffer, sizeof(event_name_buffer));
+  TRACE(trace_choose, event_state, event_index);
+}
+
+void update_seconds(struct tm *tick_time) {
+  char next[sizeof(seconds_buffer)];
+  strftime(next, sizeof(next), ":%S", tick_time);
+  // Display this time on the face
+  set_text_if_changed(SECONDS_RECT, seconds_buffer, next, sizeof(seconds_buffer), &redraws.seconds);
+}
 
-  strftime(minutes_buffer, sizeof("00"), "%M", tick_time);
-  // Display this time on the TextLayer
-  text_layer_set_text(minutes_layer, minutes_buffer);
+void update_minutes(struct tm *tick_time) {
+  char next[sizeof(minutes_buffer)];
+  strftime(next, sizeof(next), "%M", tick_time);
+  // Display this time on the face
+  set_text_if_changed(MINUTES_RECT, minutes_buffer, next, sizeof(minutes_buffer), &redraws.minutes);
 }
 
-void update_hours() {
-  // Get a tm structure
-  time_t temp = time(NULL); 
-  struct tm *tick_time = localtime(&temp);
+void update_hours(struct tm *tick_time) {
+  char next[sizeof(hours_buffer)];
+  const GBitmap *ampm;
 
   // Write the current hours into the buffer
   if(clock_is_24h_style() == true) {
     // Use 24 hour format
-    strftime(hours_buffer, sizeof("00:"), "%H:", tick_time);
-    bitmap_layer_set_bitmap(ampm_layer, ampm_blank);
+    strftime(next, sizeof(next), "%H:", tick_time);
+    ampm = ampm_blank;
   } else {
     // Use 12 hour format
     char temp[] = "00:";
     strftime(temp, sizeof("00:"), "%I:", tick_time);
     if (temp[0] == '0')
-      strncpy(hours_buffer,temp+1,3);
+      strncpy(next,temp+1,sizeof(next));
     else
-      strncpy(hours_buffer,temp,3);
-      
+      strncpy(next,temp,sizeof(next));
+
     if (tick_time->tm_hour > 11)
-      bitmap_layer_set_bitmap(ampm_layer, ampm_pm);
+      ampm = ampm_pm;
     else
-      bitmap_layer_set_bitmap(ampm_layer, ampm_am);
+      ampm = ampm_am;
   }
-  
-  // Display this time on the TextLayer
-  text_layer_set_text(hours_layer, hours_buffer);
+
+  set_bitmap_if_changed(AMPM_RECT, &ampm_shown, ampm, &redraws.ampm);
+  // Display this time on the face
+  set_text_if_changed(HOURS_RECT, hours_buffer, next, sizeof(hours_buffer), &redraws.hours);
 }
 
-void update_countdown() {
-  time_t temp = time(NULL); 
-  int diff = difftime(event_start,temp)/(60*60*24)+1;
+void update_countdown(time_t now) {
+  char next[sizeof(countdown_buffer)];
 
-  strncpy(countdown_buffer,event_name_buffer,sizeof(countdown_buffer));
+  strncpy(next,event_name_buffer,sizeof(next));
   
-  // positive diff means in the future
-  if (diff > 1000) 
-    snprintf(to_go_buffer,sizeof(to_go_buffer),"\nforever");
-  else if (diff > 1)
-    snprintf(to_go_buffer,sizeof(to_go_buffer),"\n%d days",diff);
-  else if (diff == 1)
-    snprintf(to_go_buffer,sizeof(to_go_buffer),"\n%d day",diff);
-  // diff between -length and 0 means event running
-  else if ((diff >= (1-event_length)) && (diff <= 0))
+  if (event_state == state_on)
     snprintf(to_go_buffer,sizeof(to_go_buffer),"\n%s","is ON!");
-  //diff less than -length means over
-  else if (diff < (1-event_length))
+  else if (event_state == state_over)
     snprintf(to_go_buffer,sizeof(to_go_buffer),"\n%s","is over");
+  else {
+    // counting down, calendar days until the first day of the event
+    int diff = calendar_days_until(event_day);
+    if (diff > 1000) 
+      snprintf(to_go_buffer,sizeof(to_go_buffer),"\nforever");
+    else if (diff > 1)
+      snprintf(to_go_buffer,sizeof(to_go_buffer),"\n%d days",diff);
+    else if (diff == 1)
+      snprintf(to_go_buffer,sizeof(to_go_buffer),"\n%d day",diff);
+    else
+      // the schedule hasn't turned it on yet; never less than a day
+      snprintf(to_go_buffer,sizeof(to_go_buffer),"\n1 day");
+  }
     
-  strncat(countdown_buffer,to_go_buffer,sizeof(countdown_buffer)-sizeof(to_go_buffer));
+  strncat(next,to_go_buffer,sizeof(next)-sizeof(to_go_buffer));
+
+  // Display this countdown on the face
+  set_text_if_changed(COUNTDOWN_RECT, countdown_buffer, next, sizeof(countdown_buffer), &redraws.countdown);
+}
+
+// The countdown only changes at schedule entries and, while counting
+// down, when another whole day has gone.  Rather than redoing it every
+// hour, wake up exactly when the next of those happens.
+static AppTimer *countdown_timer = NULL;
+
+static void refresh_countdown(time_t now);
+
+static void countdown_timer_callback(void *data)
+{
+  countdown_timer = NULL;
+  refresh_countdown(time(NULL));
+}
+
+static void schedule_countdown_update(time_t now)
+{
+  // never sleep more than a day so a changed clock gets picked up
+  time_t next = now + 60*60*24;
+
+  if (schedule_pos+1 < n_transitions) {
+    if (schedule[schedule_pos+1].at < next) next = schedule[schedule_pos+1].at;
+  } else if (schedule_end < next) {
+    // end of the window, choose_event will build the next one
+    next = schedule_end;
+  }
+  if (event_state == state_counting && calendar_days_until(event_day) > 0) {
+    // day count drops at local midnight
+    if (calendar_tomorrow() < next) next = calendar_tomorrow();
+  }
+
+  uint32_t delay_ms = (next > now) ? (uint32_t)(next-now)*1000 : 1000;
+  if (!countdown_timer || !app_timer_reschedule(countdown_timer, delay_ms))
+    countdown_timer = app_timer_register(delay_ms, countdown_timer_callback, NULL);
+}
+
+// Render snapshot, see face_state.h: the countdown as it was last saved
+// or restored, so an unchanged one isn't written again
+static RenderSnapshot snapshot;
+
+// the countdown text can't change before the next transition, nor while
+// counting down before midnight
+static void save_render_snapshot(void)
+{
+  if ((n_transitions == 0) || (strlen(countdown_buffer) >= RENDER_SNAPSHOT_TEXT)) return;
+
+  time_t from  = calendar_today();
+  time_t until = (schedule_pos+1 < n_transitions) ? schedule[schedule_pos+1].at : schedule_end;
+  if (schedule[schedule_pos].at > from) from = schedule[schedule_pos].at;
+  if (calendar_tomorrow() < until) until = calendar_tomorrow();
+
+  RenderSnapshot next = {
+    .version         = RENDER_SNAPSHOT_VERSION,
+    .pos             = schedule_pos,
+    .catalog_version = catalog_version(),
+    .utc_offset      = calendar_utc_offset(),
+    .from            = from,
+    .until           = until,
+    .index           = event_index,
+    .state           = event_state,
+    .day             = event_day,
+    .length          = event_length,
+  };
+  memcpy(next.settings, settings_packed, sizeof(settings_packed));
+  // fits, with its NUL, as checked above
+  memcpy(next.countdown, countdown_buffer, strlen(countdown_buffer)+1);
+  if (memcmp(&next, &snapshot, sizeof(next)) == 0) return;
+
+  STATS_INC(stat_persist_write);
+  if (persist_write_data(RENDER_SNAPSHOT_KEY, &next, sizeof(next)) == (int)sizeof(next))
+    snapshot = next;
+}
 
-  // Display this countdown on the TextLayer
-  text_layer_set_text(countdown_layer, countdown_buffer);
+// Put the saved countdown back without choosing the event, if it was
+// drawn from the schedule load_face_state() just read and now is still
+// in its span; false if it is stale
+static bool restore_render_snapshot(time_t now)
+{
+  RenderSnapshot saved;
+  int read = persist_read_data(RENDER_SNAPSHOT_KEY, &saved, sizeof(saved));
+  STATS_INC(stat_persist_read);
+  if ((read != (int)sizeof(saved)) || (saved.version != RENDER_SNAPSHOT_VERSION) ||
+      (saved.pos != schedule_pos) || (schedule_pos >= n_transitions) ||
+      (saved.index != schedule[schedule_pos].index) || (saved.state != schedule[schedule_pos].state) ||
+      (saved.catalog_version != catalog_version()) ||
+      (saved.utc_offset != calendar_utc_offset()) ||
+      (memcmp(saved.settings, settings_packed, sizeof(settings_packed)) != 0) ||
+      (now < saved.from) || (now >= saved.until) ||
+      (saved.countdown[RENDER_SNAPSHOT_TEXT-1] != '\0'))
+    return false;
+
+  // event_name_buffer stays empty; choose_event fills it before the
+  // countdown is next formatted
+  event_index  = saved.index;
+  event_state  = saved.state;
+  event_day    = saved.day;
+  event_length = saved.length;
+  set_text_if_changed(COUNTDOWN_RECT, countdown_buffer, saved.countdown, sizeof(countdown_buffer),
+                      &redraws.countdown);
+  snapshot = saved;
+  return true;
+}
+
+static void refresh_countdown(time_t now)
+{
+  // a new day; if the UTC offset moved with it, so did every transition
+  if (calendar_update(now) && calendar_offset_changed()) n_transitions = 0;
+  choose_event(now);
+  update_countdown(now);
+  schedule_countdown_update(now);
 }
 
 static void handle_battery(BatteryChargeState charge_state) {
+  TRACE(trace_battery, charge_state.charge_percent,
+        (charge_state.is_charging ? 1 : 0) | (charge_state.is_plugged ? 2 : 0));
   if (charge_state.is_charging)
-    bitmap_layer_set_bitmap(battery_layer, battery_charging);
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_charging, &redraws.battery);
   else if (charge_state.is_plugged)
-    bitmap_layer_set_bitmap(battery_layer, battery_connected);
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_connected, &redraws.battery);
   else if (charge_state.charge_percent >80)
-    bitmap_layer_set_bitmap(battery_layer, battery_100);
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_100, &redraws.battery);
   else if (charge_state.charge_percent >60)
-    bitmap_layer_set_bitmap(battery_layer, battery_80);
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_80, &redraws.battery);
   else if (charge_state.charge_percent >40)
-    bitmap_layer_set_bitmap(battery_layer, battery_60);
-  else if (charge_state.charge_percent >20)
-    bitmap_layer_set_bitmap(battery_layer, battery_40);
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_60, &redraws.battery);
   else if (charge_state.charge_percent >20)
-    bitmap_layer_set_bitmap(battery_layer, battery_20);
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_40, &redraws.battery);
+  else if (charge_state.charge_percent >10)
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_20, &redraws.battery);
   else
-    bitmap_layer_set_bitmap(battery_layer, battery_empty);
+    set_bitmap_if_changed(BATTERY_RECT, &battery_shown, battery_empty, &redraws.battery);
+
+  refresh_battery(charge_state);
 }
 
 static bool bt_connect_state;
 
 static void handle_bluetooth(bool connected) {
+  TRACE(trace_bluetooth, connected, 0);
   if (connected)
-    bitmap_layer_set_bitmap(bt_layer, bt_connected);
+    set_bitmap_if_changed(BT_RECT, &bt_shown, bt_connected, &redraws.bt);
   else
-    bitmap_layer_set_bitmap(bt_layer, bt_disconnected);
+    set_bitmap_if_changed(BT_RECT, &bt_shown, bt_disconnected, &redraws.bt);
+
+  refresh_bluetooth(connected);
+#if USE_SET_PEBBLE
+  outbox_connected(connected);
+#endif
 }
 
 static BatteryChargeState battery_state;
 
+// Everything a tick draws comes from the tick_time we are handed plus at
+// most one read of the clock once a day; each update only touches its
+// part of the face when the content changed
 static void seconds_handler(struct tm *tick_time, TimeUnits units_changed) {
-  // once a day look to see if we have passed an event
-  if (units_changed & DAY_UNIT) {
-    choose_event();
-    update_countdown();
+  STATS_TICK(units_changed);
+  TRACE_TICK(units_changed);
+  // keep the overlay's numbers current
+  if (STATS_OVERLAY_SHOWN()) mark_dirty(COUNTDOWN_RECT);
+
+  // the countdown timer handles event changes; once a day resync anyway
+  // in case the clock was changed under us
+  if (units_changed & DAY_UNIT) refresh_countdown(time(NULL));
+  if (units_changed & HOUR_UNIT) update_hours(tick_time);
+
+  if (units_changed & MINUTE_UNIT) update_minutes(tick_time);
+  if (units_changed & SECOND_UNIT) update_seconds(tick_time);
+}
+
+static void refresh_mode_changed(TimeUnits units)
+{
+  bool show_seconds = (units == SECOND_UNIT);
+  if (show_seconds != seconds_shown) {
+    seconds_shown = show_seconds;
+    mark_dirty(SECONDS_RECT);
+  }
+  // seconds have been frozen while hidden
+  if (show_seconds) {
+    time_t now = time(NULL);
+    update_seconds(localtime(&now));
   }
+}
+
+// the next startup stage still to run, see handle_init()
+static AppTimer *startup_timer = NULL;
 
-  if (units_changed & HOUR_UNIT)   {
-    update_countdown();
-    update_hours();
+// cached glyphs when we have them, the text renderer otherwise
+static void draw_digits(const GlyphCache *cache, GContext *ctx, const char *text, GFont font,
+                        GRect box, GTextAlignment alignment)
+{
+  if (!glyphs_draw(cache, ctx, text, box, alignment))
+    graphics_draw_text(ctx, text, font, box, GTextOverflowModeWordWrap, alignment, NULL);
+}
+
+static void face_update_proc(Layer *layer, GContext *ctx)
+{
+  if (grect_within(face_dirty, SECONDS_RECT)) {
+    // a seconds tick: repaint their background and draw them again
+    graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+    graphics_draw_bitmap_in_rect(ctx, seconds_background, SECONDS_RECT);
+    STATS_INC(stat_frame_seconds);
+  } else {
+    // the first full frame renders the glyphs before covering them up
+    glyphs_render(&time_glyphs, ctx);
+    glyphs_render(&seconds_glyphs, ctx);
+
+#if defined(PBL_ROUND)
+    // the corners of the background art are off the edge of the circle
+    graphics_context_set_fill_color(ctx, GColorWhite);
+    graphics_fill_rect(ctx, FACE_RECT, 0, GCornerNone);
+#endif
+    graphics_context_set_compositing_mode(ctx, GCompOpAssign);
+    graphics_draw_bitmap_in_rect(ctx, s_background_bitmap, BACKGROUND_RECT);
+
+    // indicators go over the background, see layout.h
+    graphics_context_set_compositing_mode(ctx, INDICATOR_COMPOSITING);
+    if (battery_shown) graphics_draw_bitmap_in_rect(ctx, battery_shown, BATTERY_RECT);
+    if (bt_shown) graphics_draw_bitmap_in_rect(ctx, bt_shown, BT_RECT);
+    if (ampm_shown) graphics_draw_bitmap_in_rect(ctx, ampm_shown, AMPM_RECT);
+
+    graphics_context_set_text_color(ctx, GColorBlack);
+    draw_digits(&time_glyphs, ctx, hours_buffer, time_font, HOURS_RECT, GTextAlignmentRight);
+    draw_digits(&time_glyphs, ctx, minutes_buffer, time_font, MINUTES_RECT, GTextAlignmentLeft);
+#if STATS_ENABLED
+    if (stats_overlay_shown()) {
+      // the debug overlay takes the countdown's place
+      char summary[160];
+      stats_format(summary, sizeof(summary));
+      graphics_context_set_fill_color(ctx, GColorWhite);
+      graphics_fill_rect(ctx, COUNTDOWN_RECT, 0, GCornerNone);
+      graphics_draw_text(ctx, summary, stats_font, COUNTDOWN_RECT,
+                         GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
+    } else
+#endif
+    graphics_draw_text(ctx, countdown_buffer, countdown_font, COUNTDOWN_RECT,
+                       GTextOverflowModeWordWrap, GTextAlignmentCenter, NULL);
+    STATS_INC(stat_frame_full);
+    STATS_STARTUP(stage_first_frame);
   }
-  
-  if (units_changed & MINUTE_UNIT) update_minutes();
-  if (units_changed & SECOND_UNIT) update_seconds();
+
+  if (seconds_shown) {
+    graphics_context_set_text_color(ctx, GColorBlack);
+    draw_digits(&seconds_glyphs, ctx, seconds_buffer, seconds_font, SECONDS_RECT, GTextAlignmentLeft);
+  }
+  face_dirty = GRect(0, 0, 0, 0);
+  STATS_HEAP();
+
+  // the time is up, carry on with startup
+  if (startup_timer && !indicator_atlas) app_timer_reschedule(startup_timer, 0);
+}
+
+#if STATS_ENABLED
+static void stats_overlay_changed(bool shown)
+{
+  mark_dirty(COUNTDOWN_RECT);
+}
+#endif
+
+// whatever was on screen while we were covered is gone
+static void window_appear(Window *window)
+{
+  mark_dirty(FACE_RECT);
 }
 
 static void app_error_callback(DictionaryResult dict_error, AppMessageResult app_message_error, void* context) {
-  APP_LOG(APP_LOG_LEVEL_DEBUG, "app error %d", app_message_error);
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "app error %d, dict error %d", app_message_error, dict_error);
 }
 
-static int get_index(const char *which)
+#if USE_SET_PEBBLE
+static AppTimer *sync_timer = NULL;
+
+static void sync_settled(void *data)
 {
-  int idx = -1;
-  int size = sizeof(which);
-  for (unsigned int i=1; i<n_events; ++i) {
-    if (strncmp(which,event[i].name,size)==0) {
-      idx = i;
-      break;
-    }
-  }
-  return idx;
+  //APP_LOG(APP_LOG_LEVEL_DEBUG, "SetPabble setting changed");
+  sync_timer = NULL;
+  time_t now = time(NULL);
+  build_schedule(now);
+  refresh_countdown(now);
+}
+
+// Only touches the settings store (and so reads it in) when the setting
+// differs from the packed copy we started with
+static bool apply_setting(unsigned int key, bool enable)
+{
+  uint8_t bit = 1 << ((key-1)%8);
+  if (((settings_packed[1+(key-1)/8] & bit) != 0) == enable) return false;
+
+  settings_set_enabled(setting_event_id[key], enable);
+  settings_packed[1+(key-1)/8] ^= bit;
+  TRACE(trace_setting, enable, setting_event_id[key]);
+  return true;
 }
 
-static bool update_event(char *name, uint8_t value)
+static bool unpack_settings(const Tuple *tuple)
 {
+  const uint8_t *packed = tuple->value->data;
   bool changed = false;
-  int idx = get_index(name);
-  if (idx>-1) {
-    if ((value < 2) && (event[idx].enabled != value)) {
-      //  update value
-      event[idx].enabled = value;
-      uint8_t id = index_to_id(idx);
-      store_setting(id,value);
-      changed = true;
-    }
+  if ((tuple->length < 1+SETTINGS_MASK_BYTES) || (packed[0] != SETTINGS_SCHEMA)) return false;
+
+  for (unsigned int key = 1; key < setting_count; ++key) {
+    bool enable = (packed[1+(key-1)/8] & (1 << ((key-1)%8))) != 0;
+    if (apply_setting(key, enable)) changed = true;
   }
-  return (changed);
+  return changed;
 }
 
-#if USE_SET_PEBBLE
 static void tuple_changed_callback(const uint32_t key, const Tuple* tuple_new, const Tuple* tuple_old, void* context) {
-  //  we know these values are uint8 format
-  int value = tuple_new->value->uint8;
   bool changed = false;
-  switch (key) {
-    case setting_MOTD:
-      if(update_event("MOTD",value)) changed = true;
-      break;
-    case setting_AMVIV:
-      if(update_event("AMVIV",value)) changed = true;
-      break;
-    case setting_MOT:
-      if(update_event("MOT",value)) changed = true;
-      break;
-    case setting_MME:
-      if(update_event("MME",value)) changed = true;
-      break;
-    case setting_MACK:
-      if(update_event("MACK",value)) changed = true;
-      break;
-    case setting_MITM:
-      if(update_event("MITM",value)) changed = true;
-      break;
-    case setting_MandM:
-      if(update_event("MandM",value)) changed = true;
-      break;
-    case setting_MiF:
-      if(update_event("MiF",value)) changed = true;
-      break;
-    case setting_MSSD:
-      if(update_event("MSSD",value)) changed = true;
-      break;
-    case setting_MITO:
-      if(update_event("MITO",value)) changed = true;
-      break;
-  }
-  if (changed) {
-    //APP_LOG(APP_LOG_LEVEL_DEBUG, "SetPabble setting changed");
-    choose_event();
-    update_countdown();
+
+  STATS_INC(stat_sync_callback);
+
+  //  update values, written back on exit
+  if (key == STREAM_CHUNK_KEY) {
+    // kept in the ring, written back on exit; ask for the next chunk
+    // straight away, one at a time until the ring is full
+    changed = stream_receive(tuple_new->value->data, tuple_new->length);
+    if (changed && stream_wants_more()) outbox_request(ACTION_EVENTS);
+    // a reset moves every index the schedule holds
+    if (changed) n_transitions = 0;
+  } else {
+    if (key == SETTINGS_PACKED_KEY) {
+      changed = unpack_settings(tuple_new);
+    } else if ((key > 0) && (key < setting_count)) {
+      //  0 or 1, as an int32 from PebbleKit JS or a single byte
+      int32_t value = (tuple_new->length == sizeof(int32_t)) ? tuple_new->value->int32 :
+                                                                tuple_new->value->uint8;
+      if ((value >= 0) && (value < 2)) changed = apply_setting(key, value);
+    }
+    // the companion only streams enabled events; our cursor tells it the
+    // ones we hold are from the old settings
+    if (changed && stream_active()) outbox_request(ACTION_EVENTS);
   }
+  TRACE(trace_sync, changed, key);
+  if (!changed) return;
+
+  // pick the event again once the rest of this burst has arrived
+  if (!sync_timer || !app_timer_reschedule(sync_timer, SYNC_SETTLE_MS))
+    sync_timer = app_timer_register(SYNC_SETTLE_MS, sync_settled, NULL);
+}
+#endif
+
+#if USE_SET_PEBBLE
+// every message we send is an action with the settings and the stream
+// cursor we have
+static void write_message(DictionaryIterator *iter, uint8_t action)
+{
+  StreamCursor cursor;
+  stream_cursor(&cursor);
+  dict_write_uint8(iter, ACTION_KEY, action);
+  dict_write_data(iter, SETTINGS_PACKED_KEY, settings_packed, sizeof(settings_packed));
+  dict_write_data(iter, STREAM_CURSOR_KEY, (const uint8_t *)&cursor, sizeof(cursor));
 }
 #endif
 
-static void get_setting(char * event, EventSetting *setting)
+// 1 if the packed settings have key enabled, for SETTINGS_TUPLETS; as an
+// int32, the width the companion sends, so merging its values never grows
+// the AppSync dictionary
+#define setting_packed_enabled(key) ((int32_t)((settings_packed[1+((key)-1)/8] >> (((key)-1)%8)) & 1))
+
+// Startup is staged so the time is on screen as early as possible:
+//   1. handle_init: the window, time and the last known countdown
+//   2. after the first frame: battery, Bluetooth and AM/PM indicators
+//   3. then AppSync, which reconciles settings
+// Each stage is timed, see STATS_STARTUP.
+static bool      sync_started = false;
+
+static void startup_sync(void *data)
 {
-  bool enable;
-  if (recall_setting(index_to_id(get_index(event)),&enable)) {
-    *setting  = enable?event_on:event_off;
+  startup_timer = NULL;
+
+  // a first run after an upgrade went up with every event enabled; pick
+  // up what the old version had turned off before the companion is asked
+  if (settings_migrate(setting_event_id + 1, setting_count - 1)) {
+    time_t now = time(NULL);
+    pack_settings(settings_packed);
+    build_schedule(now);
+    refresh_countdown(now);
   }
-}
 
-void handle_init(void) {
+#if USE_SET_PEBBLE
+  //  app communication, starting from the values we last knew, and room
+  //  for a chunk of events; an empty one is ignored
+  uint8_t no_chunk[STREAM_CHUNK_SIZE] = { 0 };
+  Tuplet tuples[] = {
+    SETTINGS_TUPLETS(setting_packed_enabled)
+    TupletBytes(SETTINGS_PACKED_KEY, settings_packed, sizeof(settings_packed)),
+    TupletBytes(STREAM_CHUNK_KEY, no_chunk, sizeof(no_chunk))
+  };
+  
+  app_message_open(INBOX_SIZE, ACTION_OUTBOX_SIZE);
+  app_sync_init(&app, buffer, sizeof(buffer), tuples, ARRAY_LENGTH(tuples),
+                tuple_changed_callback, app_error_callback, NULL);
+  sync_started = true;
 
-  // Create a window and text layer
-	window = window_create();
+  // and tell the companion what we have, in case it has something newer;
+  // a companion that streams events starts or resets the ring from this
+  outbox_init(write_message);
+  outbox_request(ACTION_SETTINGS);
+#endif
+  STATS_STARTUP(stage_sync);
+  // the face is up, so logging the trace can't hold it back
+  TRACE_DUMP();
+}
 
-  // background
-  // Create GBitmap, then set to created BitmapLayer
-  s_background_bitmap = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BACKGROUND);
-  s_background_layer = bitmap_layer_create(GRect(0, 0, 144, 168));
-  bitmap_layer_set_bitmap(s_background_layer, s_background_bitmap);
-  layer_add_child(window_get_root_layer(window), bitmap_layer_get_layer(s_background_layer));
+static void startup_indicators(void *data)
+{
+  startup_timer = NULL;
+
+  // Indicators share one atlas resource; the sub-bitmaps only add headers
+#if STATS_ENABLED
+  size_t heap_before = heap_bytes_free();
+#endif
+  indicator_atlas = gbitmap_create_with_resource(RESOURCE_ID_INDICATOR_ATLAS);
 
   // Battery Indicator
   // Create GBitmaps for empty battery, and all the other states
-  battery_empty     = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_EMPTY);
-  battery_20        = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_20);
-  battery_40        = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_40);
-  battery_60        = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_60);
-  battery_80        = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_80);
-  battery_100       = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_100);
-  battery_connected = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_CONNECTED);
-  battery_charging  = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_CHARGING);
-  battery_basic     = gbitmap_create_with_resource(RESOURCE_ID_BATTERY_BASIC);
-
-  battery_layer = bitmap_layer_create(GRect(121, 0, 22, 10));
-  bitmap_layer_set_compositing_mode(battery_layer,GCompOpAnd);
-  bitmap_layer_set_bitmap(battery_layer, battery_basic);
-  layer_add_child(window_get_root_layer(window), bitmap_layer_get_layer(battery_layer));
+  battery_empty     = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_EMPTY);
+  battery_20        = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_20);
+  battery_40        = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_40);
+  battery_60        = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_60);
+  battery_80        = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_80);
+  battery_100       = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_100);
+  battery_connected = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_CONNECTED);
+  battery_charging  = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_CHARGING);
+  battery_basic     = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BATTERY_BASIC);
 
   // bluetooth indicator
   // Create GBitmaps for connected/disconnected Bluetooth
-  bt_connected = gbitmap_create_with_resource(RESOURCE_ID_BT_CONNECTED);
-  bt_disconnected = gbitmap_create_with_resource(RESOURCE_ID_BT_DISCONNECTED);
-  bt_layer = bitmap_layer_create(GRect(0, 0, 18, 10));
-  bitmap_layer_set_compositing_mode(bt_layer,GCompOpAnd);
-  bitmap_layer_set_bitmap(bt_layer, battery_basic);
-  layer_add_child(window_get_root_layer(window), bitmap_layer_get_layer(bt_layer));
+  bt_connected    = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BT_CONNECTED);
+  bt_disconnected = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_BT_DISCONNECTED);
 
   // AM/PM indicator
   // Create GBitmaps for blank/AM/PM
-  ampm_blank = gbitmap_create_with_resource(RESOURCE_ID_AMPM_BLANK);
-  ampm_am    = gbitmap_create_with_resource(RESOURCE_ID_AMPM_AM);
-  ampm_pm    = gbitmap_create_with_resource(RESOURCE_ID_AMPM_PM);
-  ampm_layer = bitmap_layer_create(GRect(0, 98-25, 22, 25));
-  bitmap_layer_set_compositing_mode(ampm_layer,GCompOpAnd);
-  bitmap_layer_set_bitmap(ampm_layer, ampm_blank);
-  layer_add_child(window_get_root_layer(window), bitmap_layer_get_layer(ampm_layer));
-
-  // set up hours display
-  hours_layer =   text_layer_create(GRect(21, 63, 52, 40));
-	
-	// Set the text, font, and text alignment
-  text_layer_set_background_color(hours_layer, GColorClear);
-  text_layer_set_text_color(hours_layer, GColorBlack);
-	text_layer_set_font(hours_layer, fonts_get_system_font(FONT_KEY_BITHAM_34_MEDIUM_NUMBERS));
-	text_layer_set_text_alignment(hours_layer, GTextAlignmentRight);
-
-	// Add the text layer to the window
-	layer_add_child(window_get_root_layer(window), text_layer_get_layer(hours_layer));
-
-  minutes_layer = text_layer_create(GRect(73, 63, 46, 40));
-
-	// Set the text, font, and text alignment
-  text_layer_set_background_color(minutes_layer, GColorClear);
-  text_layer_set_text_color(minutes_layer, GColorBlack);
-	text_layer_set_font(minutes_layer, fonts_get_system_font(FONT_KEY_BITHAM_34_MEDIUM_NUMBERS ));
-	text_layer_set_text_alignment(minutes_layer, GTextAlignmentLeft);
-
-	layer_add_child(window_get_root_layer(window), text_layer_get_layer(minutes_layer));
-
-  // set up seconds display
-  seconds_layer = text_layer_create(GRect(119, 63, 25, 25));
-	
-	// Set the text, font, and text alignment
-  text_layer_set_background_color(seconds_layer, GColorClear);
-  text_layer_set_text_color(seconds_layer, GColorBlack);
-	text_layer_set_font(seconds_layer, fonts_get_system_font(FONT_KEY_GOTHIC_24_BOLD));
-	text_layer_set_text_alignment(seconds_layer, GTextAlignmentLeft);
-
-	// Add the text layer to the window
-	layer_add_child(window_get_root_layer(window), text_layer_get_layer(seconds_layer));
-
-  // set up countdown display
-  countdown_layer = text_layer_create(GRect(0, 96, 144, 72));
-	
-	// Set the text, font, and text alignment
-  text_layer_set_background_color(countdown_layer, GColorClear);
-  text_layer_set_text_color(countdown_layer, GColorBlack);
-	text_layer_set_font(countdown_layer, fonts_get_system_font(FONT_KEY_BITHAM_30_BLACK ));
-	text_layer_set_text_alignment(countdown_layer, GTextAlignmentCenter);
-
-	// Add the text layer to the window
-	layer_add_child(window_get_root_layer(window), text_layer_get_layer(countdown_layer));
-
-  // register a handler for each one second tick
-  tick_timer_service_subscribe(SECOND_UNIT, seconds_handler);
-  
+  ampm_blank = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_AMPM_BLANK);
+  ampm_am    = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_AMPM_AM);
+  ampm_pm    = gbitmap_create_as_sub_bitmap(indicator_atlas, ATLAS_AMPM_PM);
+#if STATS_ENABLED
+  APP_LOG(APP_LOG_LEVEL_DEBUG, "indicators: heap free %d -> %d",
+          (int)heap_before, (int)heap_bytes_free());
+#endif
+
   // handler for battery events
   battery_state_service_subscribe(handle_battery);
 
   // handler for Bluetooth events
   bluetooth_connection_service_subscribe(handle_bluetooth);
 
-	// Push the window
-	window_stack_push(window, true);
-  
   // update battery status
   battery_state = battery_state_service_peek();
   handle_battery(battery_state);
@@ -564,101 +983,160 @@ void handle_init(void) {
   // update Bluetooth indicator
   bt_connect_state = bluetooth_connection_service_peek();
   handle_bluetooth(bt_connect_state);
-	
-#if USE_SET_PEBBLE
-  // set initial values from persistent storage
-  get_setting("MOTD" , &motd );
-  get_setting("AMVIV", &amviv);
-  get_setting("MOT"  , &mot  );
-  get_setting("MME"  , &mme  );
-  get_setting("MACK" , &mack );
-  get_setting("MITM" , &mitm );
-  get_setting("MandM", &mandm);
-  get_setting("MiF"  , &mif  );
-  get_setting("MSSD" , &mssd );
-  get_setting("MITO" , &mito );
-
-  //  app communication
-  Tuplet tuples[] = {
-    TupletInteger(setting_MOTD,  motd),
-    TupletInteger(setting_AMVIV, amviv),
-    TupletInteger(setting_MOT,   mot),
-    TupletInteger(setting_MME,   mme),
-    TupletInteger(setting_MACK,  mack),
-    TupletInteger(setting_MITM,  mitm),
-    TupletInteger(setting_MandM, mandm),
-    TupletInteger(setting_MiF,   mif),
-    TupletInteger(setting_MSSD,  mssd),
-    TupletInteger(setting_MITO,  mito)
-  };
-  
-  app_message_open(app_message_inbox_size_maximum(), app_message_outbox_size_maximum());
 
-//  uint32_t bufsize = dict_calc_buffer_size_from_tuplets(tuples,ARRAY_LENGTH(tuples));
-//  APP_LOG(APP_LOG_LEVEL_DEBUG, "Need a buffer this big: %lu", bufsize);
+  // and AM/PM, which stage 1 had no bitmaps for
+  time_t now = time(NULL);
+  update_hours(localtime(&now));
 
-  app_sync_init(&app, buffer, sizeof(buffer), tuples, ARRAY_LENGTH(tuples),
-                tuple_changed_callback, app_error_callback, NULL);
-#else
-  recall_all_settings();
+  STATS_STARTUP(stage_indicators);
+  startup_timer = app_timer_register(0, startup_sync, NULL);
+}
+
+void handle_init(void) {
+
+#if STATS_ENABLED
+  stats_init(stats_overlay_changed);
 #endif
+  TRACE_INIT();
 
-  choose_event();
+  // the schedule is read from the catalog resource as needed; the
+  // settings store only when a setting changes or a new schedule window
+  // is built, see load_face_state()
+  catalog_init();
+
+  // Create a window and the face layer
+	window = window_create();
+  // keep the last frame in the frame buffer, see face_dirty
+  window_set_background_color(window, GColorClear);
+  window_set_window_handlers(window, (WindowHandlers) {
+    .appear = window_appear,
+  });
+
+  face_layer = layer_create(FACE_RECT);
+  layer_set_update_proc(face_layer, face_update_proc);
+  layer_add_child(window_get_root_layer(window), face_layer);
+
+  time_font      = fonts_get_system_font(TIME_FONT);
+  seconds_font   = fonts_get_system_font(SECONDS_FONT);
+  countdown_font = fonts_get_system_font(COUNTDOWN_FONT);
+#if STATS_ENABLED
+  stats_font     = fonts_get_system_font(FONT_KEY_GOTHIC_14);
+#endif
+  glyphs_init(&time_glyphs, time_font, HOURS_RECT.size.h);
+  glyphs_init(&seconds_glyphs, seconds_font, SECONDS_RECT.size.h);
+
+  // background
+  s_background_bitmap = gbitmap_create_with_resource(RESOURCE_ID_IMAGE_BACKGROUND);
+  seconds_background  = gbitmap_create_as_sub_bitmap(s_background_bitmap,
+    GRect(SECONDS_RECT.origin.x - BACKGROUND_RECT.origin.x, SECONDS_RECT.origin.y - BACKGROUND_RECT.origin.y,
+          SECONDS_RECT.size.w, SECONDS_RECT.size.h));
+
+  // one read for the schedule window and the settings, and one for the
+  // countdown we last showed; the long way round only when there is no
+  // usable face state
+  time_t now = time(NULL);
+  calendar_update(now);
+  struct tm *tick_time = localtime(&now);
+  bool resumed = false;
+  if (load_face_state(now)) {
+    resumed = restore_render_snapshot(now);
+  } else {
+    pack_settings(settings_packed);
+    build_schedule(now);
+  }
 
   // write initial time and countdown values
-  update_hours();
-  update_minutes();
-  update_seconds();
-  update_countdown();
+  update_hours(tick_time);
+  update_minutes(tick_time);
+  update_seconds(tick_time);
+  if (resumed)
+    schedule_countdown_update(now);
+  else
+    refresh_countdown(now);
+
+  // register a handler for each one second (or minute) tick
+  static const RefreshConfig refresh_config = {
+    .low_battery_percent    = REFRESH_LOW_BATTERY,
+    .slow_when_disconnected = REFRESH_SLOW_DISCONNECTED,
+    .tap_wake_seconds       = REFRESH_TAP_WAKE_SECONDS,
+    .idle_minutes           = REFRESH_IDLE_MINUTES,
+#if STATS_ENABLED
+    .tap_observer           = stats_tap,
+#endif
+  };
+  refresh_init(&refresh_config, seconds_handler, refresh_mode_changed);
+
+	// Push the window
+	window_stack_push(window, true);
+  STATS_STARTUP(stage_face);
+
+  // the first frame brings stage 2 forward, see face_update_proc(); this
+  // is in case it never comes
+  startup_timer = app_timer_register(STARTUP_STAGE_MS, startup_indicators, NULL);
  
   // App Logging!
 	//APP_LOG(APP_LOG_LEVEL_DEBUG, "Just pushed a window!");
 }
 
 void handle_deinit(void) {
-  tick_timer_service_unsubscribe();
+  refresh_deinit();
+#if STATS_ENABLED
+  stats_deinit();
+#endif
+  if (countdown_timer) app_timer_cancel(countdown_timer);
+  if (startup_timer) app_timer_cancel(startup_timer);
   battery_state_service_unsubscribe();
   bluetooth_connection_service_unsubscribe();
 
-  store_all_settings();
+  save_render_snapshot();
+  settings_flush();
+  stream_flush();
+  TRACE_FLUSH();
   
 #if USE_SET_PEBBLE
-  app_sync_deinit(&app);
+  if (sync_started) {
+    outbox_deinit();
+    app_sync_deinit(&app);
+  }
+  sync_started = false;
+  if (sync_timer) app_timer_cancel(sync_timer);
 #endif
   
-  // Destroy the text layers
-	text_layer_destroy(countdown_layer);
-  text_layer_destroy(seconds_layer);
-	text_layer_destroy(minutes_layer);
-	text_layer_destroy(hours_layer);
-	
-  // Destroy BitmapLayer
-  bitmap_layer_destroy(battery_layer);
-  bitmap_layer_destroy(bt_layer);
-  bitmap_layer_destroy(ampm_layer);
-  bitmap_layer_destroy(s_background_layer);
+  // Destroy the face layer
+  layer_destroy(face_layer);
+  face_layer = NULL;
+  glyphs_deinit(&seconds_glyphs);
+  glyphs_deinit(&time_glyphs);
 
 	// Destroy the window
 	window_destroy(window);
 
-  // Destroy GBitmaps
-  gbitmap_destroy(bt_connected);
-  gbitmap_destroy(bt_disconnected);
-  
-  gbitmap_destroy(battery_basic);
-  gbitmap_destroy(battery_20);
-  gbitmap_destroy(battery_40);
-  gbitmap_destroy(battery_60);
-  gbitmap_destroy(battery_80);
-  gbitmap_destroy(battery_100);
-  gbitmap_destroy(battery_charging);
-  gbitmap_destroy(battery_empty);
-  gbitmap_destroy(battery_connected);
-
-  gbitmap_destroy(ampm_blank);
-  gbitmap_destroy(ampm_am);
-  gbitmap_destroy(ampm_pm);
+  // Destroy GBitmaps, if stage 2 got as far as making them
+  if (indicator_atlas) {
+    gbitmap_destroy(bt_connected);
+    gbitmap_destroy(bt_disconnected);
+
+    gbitmap_destroy(battery_basic);
+    gbitmap_destroy(battery_20);
+    gbitmap_destroy(battery_40);
+    gbitmap_destroy(battery_60);
+    gbitmap_destroy(battery_80);
+    gbitmap_destroy(battery_100);
+    gbitmap_destroy(battery_charging);
+    gbitmap_destroy(battery_empty);
+    gbitmap_destroy(battery_connected);
+
+    gbitmap_destroy(ampm_blank);
+    gbitmap_destroy(ampm_am);
+    gbitmap_destroy(ampm_pm);
+
+    // only after every sub-bitmap cut from it
+    gbitmap_destroy(indicator_atlas);
+    indicator_atlas = NULL;
+    battery_shown = bt_shown = ampm_shown = NULL;
+  }
 
+  gbitmap_destroy(seconds_background);
   gbitmap_destroy(s_background_bitmap);
 }
 
@@ -666,4 +1144,5 @@ int main(void) {
 	handle_init();
 	app_event_loop();
 	handle_deinit();
+	return 0;
 }
@@ -0,0 +1,66 @@
+#pragma once
+
+// Face state
+//
+// The face keeps its schedule window (see countdown.c) and the packed
+// settings under one persist key, so starting up is a single read; where
+// in the window we are follows from the clock.  It is written whenever
+// the face builds a new window.
+
+#define FACE_STATE_KEY          2
+#define FACE_STATE_VERSION      2
+
+// 3 entries for each of the 8 events in a window
+#define FACE_STATE_TRANSITIONS  24
+// schema byte and mask, as the companion sends them
+#define FACE_STATE_SETTINGS     3
+
+typedef struct __attribute__((__packed__)) {
+  int32_t  at;
+  uint16_t index;
+  uint8_t  state;
+} FaceTransition;
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t  version;
+  uint8_t  count;
+  uint8_t  settings[FACE_STATE_SETTINGS];
+  // the window is stale if either of these changed since it was built
+  uint32_t catalog_version;
+  int32_t  utc_offset;
+  // the window is good until here
+  int32_t  end;
+  FaceTransition transitions[FACE_STATE_TRANSITIONS];
+} FaceState;
+
+// Render snapshot
+//
+// What the face last showed, written on the way out so coming back (from
+// a notification, the menu) can put the countdown straight back on
+// screen.  It is only good while the schedule it came from is the one in
+// FaceState (same catalog, settings and UTC offset, same entry) and the
+// clock is still in [from, until), the span over which the countdown text
+// can't change.  Otherwise the face chooses the event again.
+
+#define RENDER_SNAPSHOT_KEY      3
+#define RENDER_SNAPSHOT_VERSION  2
+
+// longest countdown text kept, NUL included
+#define RENDER_SNAPSHOT_TEXT     48
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t  version;
+  // the schedule it was drawn from
+  uint8_t  pos;
+  uint8_t  settings[FACE_STATE_SETTINGS];
+  uint32_t catalog_version;
+  int32_t  utc_offset;
+  int32_t  from;
+  int32_t  until;
+  // the event shown
+  uint16_t index;
+  uint8_t  state;
+  int32_t  day;
+  int16_t  length;
+  char     countdown[RENDER_SNAPSHOT_TEXT];
+} RenderSnapshot;
@@ -0,0 +1,138 @@
+#include <pebble.h>
+#include "glyphs.h"
+
+#if defined(PBL_BW)
+
+static const char glyph_chars[GLYPH_COUNT+1] = "0123456789:";
+
+// wide enough that a single glyph never wraps
+#define GLYPH_BOX_WIDTH 64
+
+static int glyph_slot(char c)
+{
+  if ((c >= '0') && (c <= '9')) return c - '0';
+  if (c == ':') return 10;
+  return -1;
+}
+
+static void free_bitmaps(GlyphCache *cache)
+{
+  for (int i = 0; i < GLYPH_COUNT; ++i) {
+    if (cache->glyph[i]) gbitmap_destroy(cache->glyph[i]);
+    cache->glyph[i] = NULL;
+  }
+  if (cache->strip) gbitmap_destroy(cache->strip);
+  cache->strip = NULL;
+  cache->ready = false;
+}
+
+bool glyphs_init(GlyphCache *cache, GFont font, int16_t height)
+{
+  memset(cache, 0, sizeof(*cache));
+  cache->font   = font;
+  cache->height = height;
+
+  int16_t strip_width = 0;
+  for (int i = 0; i < GLYPH_COUNT; ++i) {
+    char text[2] = { glyph_chars[i], '\0' };
+    GSize size = graphics_text_layout_get_content_size(text, font, GRect(0, 0, GLYPH_BOX_WIDTH, height),
+                                                       GTextOverflowModeWordWrap, GTextAlignmentLeft);
+    cache->width[i] = size.w;
+    strip_width += size.w;
+  }
+
+  cache->strip = gbitmap_create_blank(GSize(strip_width, height));
+  if (!cache->strip) return false;
+  int16_t x = 0;
+  for (int i = 0; i < GLYPH_COUNT; ++i) {
+    cache->glyph[i] = gbitmap_create_as_sub_bitmap(cache->strip, GRect(x, 0, cache->width[i], height));
+    if (!cache->glyph[i]) {
+      free_bitmaps(cache);
+      return false;
+    }
+    x += cache->width[i];
+  }
+  return true;
+}
+
+void glyphs_deinit(GlyphCache *cache)
+{
+  free_bitmaps(cache);
+}
+
+// 1-bit rows, leftmost pixel in the least significant bit
+static void copy_cell(const GBitmap *from, GBitmap *to, int16_t to_x, int16_t width, int16_t height)
+{
+  const uint8_t *src = gbitmap_get_data(from);
+  uint8_t *dst = gbitmap_get_data(to);
+  uint16_t src_stride = gbitmap_get_bytes_per_row(from);
+  uint16_t dst_stride = gbitmap_get_bytes_per_row(to);
+  for (int16_t y = 0; y < height; ++y) {
+    const uint8_t *src_row = src + y * src_stride;
+    uint8_t *dst_row = dst + y * dst_stride;
+    for (int16_t x = 0; x < width; ++x) {
+      int16_t dx = to_x + x;
+      if (src_row[x >> 3] & (1 << (x & 7)))
+        dst_row[dx >> 3] |= 1 << (dx & 7);
+      else
+        dst_row[dx >> 3] &= ~(1 << (dx & 7));
+    }
+  }
+}
+
+bool glyphs_render(GlyphCache *cache, GContext *ctx)
+{
+  if (cache->ready || !cache->strip) return cache->ready;
+
+  int16_t x = 0;
+  for (int i = 0; i < GLYPH_COUNT; ++i) {
+    char text[2] = { glyph_chars[i], '\0' };
+    // black on white in the top left corner, the frame overwrites it
+    graphics_context_set_fill_color(ctx, GColorWhite);
+    graphics_fill_rect(ctx, GRect(0, 0, GLYPH_BOX_WIDTH, cache->height), 0, GCornerNone);
+    graphics_context_set_text_color(ctx, GColorBlack);
+    graphics_draw_text(ctx, text, cache->font, GRect(0, 0, GLYPH_BOX_WIDTH, cache->height),
+                       GTextOverflowModeWordWrap, GTextAlignmentLeft, NULL);
+
+    GBitmap *frame = graphics_capture_frame_buffer(ctx);
+    if (!frame) {
+      // draw text the slow way from now on
+      free_bitmaps(cache);
+      return false;
+    }
+    copy_cell(frame, cache->strip, x, cache->width[i], cache->height);
+    graphics_release_frame_buffer(ctx, frame);
+    x += cache->width[i];
+  }
+  cache->ready = true;
+  return true;
+}
+
+bool glyphs_draw(const GlyphCache *cache, GContext *ctx, const char *text, GRect box, GTextAlignment alignment)
+{
+  if (!cache->ready) return false;
+
+  int16_t width = 0;
+  for (const char *c = text; *c; ++c) {
+    int slot = glyph_slot(*c);
+    if (slot < 0) return false;
+    width += cache->width[slot];
+  }
+
+  int16_t x = box.origin.x;
+  if (alignment == GTextAlignmentRight)
+    x += box.size.w - width;
+  else if (alignment == GTextAlignmentCenter)
+    x += (box.size.w - width) / 2;
+
+  // white around the glyph leaves the background alone
+  graphics_context_set_compositing_mode(ctx, GCompOpAnd);
+  for (const char *c = text; *c; ++c) {
+    int slot = glyph_slot(*c);
+    graphics_draw_bitmap_in_rect(ctx, cache->glyph[slot], GRect(x, box.origin.y, cache->width[slot], cache->height));
+    x += cache->width[slot];
+  }
+  return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <pebble.h>
+
+// Digit glyph cache
+//
+// The time is only ever digits and ':', so instead of laying out and
+// rasterising text every second we render those eleven glyphs of a font
+// once, copy them out of the frame buffer into a strip bitmap, and blit
+// them from there.  Rendering needs a GContext, so glyphs_render() is
+// called from an update proc before it draws the frame.
+//
+// The copy only knows 1-bit frame buffers, so the cache is aplite only;
+// elsewhere these are stubs and the face draws text as usual.
+
+#define GLYPH_COUNT 11
+
+typedef struct {
+  GFont    font;
+  int16_t  height;
+  bool     ready;
+  GBitmap *strip;
+  GBitmap *glyph[GLYPH_COUNT];
+  uint8_t  width[GLYPH_COUNT];
+} GlyphCache;
+
+#if defined(PBL_BW)
+
+// measure the glyphs and allocate the strip; false if it didn't fit
+bool glyphs_init(GlyphCache *cache, GFont font, int16_t height);
+void glyphs_deinit(GlyphCache *cache);
+
+// draw the glyphs once and keep them; false if the cache can't be used,
+// in which case it won't try again
+bool glyphs_render(GlyphCache *cache, GContext *ctx);
+
+// draw text in box like graphics_draw_text() would, ANDed over what is
+// there; false, drawing nothing, if it isn't all cached glyphs
+bool glyphs_draw(const GlyphCache *cache, GContext *ctx, const char *text, GRect box, GTextAlignment alignment);
+
+#else
+
+static inline bool glyphs_init(GlyphCache *cache, GFont font, int16_t height)
+{
+  memset(cache, 0, sizeof(*cache));
+  return false;
+}
+static inline void glyphs_deinit(GlyphCache *cache) {}
+static inline bool glyphs_render(GlyphCache *cache, GContext *ctx) { return false; }
+static inline bool glyphs_draw(const GlyphCache *cache, GContext *ctx, const char *text, GRect box, GTextAlignment alignment)
+{
+  return false;
+}
+
+#endif
@@ -0,0 +1,22 @@
+//  The whole event catalog, which the companion streams to the watch a
+//  few events at a time.  Generated by tools/make_catalog.py from
+//  resources/data/events.json, do not edit.
+
+var eventCatalog = {
+  version: 4228098684,
+  // first day (days from 1970-01-01, local), id, length, name;
+  // sorted by first day
+  events: [
+    [16583, 2, 4, "AMVIV"],
+    [16605, 3, 2, "MOT"],
+    [16615, 4, 3, "MME"],
+    [16647, 5, 2, "MACK"],
+    [16652, 6, 5, "MITM"],
+    [16703, 7, 3, "MandM"],
+    [16709, 8, 4, "MiF"],
+    [16717, 9, 3, "MSSD"],
+    [16730, 10, 4, "MITO"],
+    [16933, 1, 5, "MOTD"],
+    [2932895, 255, 0, "MINI"]
+  ]
+};
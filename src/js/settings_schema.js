@@ -0,0 +1,17 @@
+//  Event settings for the configuration page: key, event id, name and
+//  title.
+//  Generated by tools/make_catalog.py from resources/data/events.json,
+//  do not edit.
+
+var eventSettings = [
+  { key: 1, id: 1, name: "MOTD", title: "MINIs on the Dragon 5/12/2016" },
+  { key: 2, id: 2, name: "AMVIV", title: "A MINI Vacation in Vegas 5/28" },
+  { key: 3, id: 3, name: "MOT", title: "MINIs on Top 6/19" },
+  { key: 4, id: 4, name: "MME", title: "MINI Meet East 6/29" },
+  { key: 5, id: 5, name: "MACK", title: "MINIs on the Mack 7/31" },
+  { key: 6, id: 6, name: "MITM", title: "MINIs in the Mountains 8/5" },
+  { key: 7, id: 7, name: "MandM", title: "Mickey and MINI 9/25" },
+  { key: 8, id: 8, name: "MiF", title: "MINIs in Foliage 10/1" },
+  { key: 9, id: 9, name: "MSSD", title: "MINIs Slay the Sleeping Dragon 10/9" },
+  { key: 10, id: 10, name: "MITO", title: "MINIS in the Ozarks 10/22" }
+];
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <pebble.h>
+
+// Face layout for each platform
+//
+// Aplite and basalt share the 144x168 layout the background was drawn
+// for.  Chalk's display is a 180x180 circle, so the same art sits in the
+// middle of it with everything moved along, the indicators pulled in
+// from the corners the circle cuts off, and a smaller countdown font so
+// its lines clear the bottom of the circle.  The background is drawn at
+// BACKGROUND_RECT and everything outside it is filled white.
+
+#if defined(PBL_ROUND)
+
+#define FACE_RECT        GRect(0, 0, 180, 180)
+#define BACKGROUND_RECT  GRect(18, 6, 144, 168)
+#define BATTERY_RECT     GRect(104, 14, 22, 10)
+#define BT_RECT          GRect(56, 14, 18, 10)
+#define AMPM_RECT        GRect(18, 79, 22, 25)
+#define HOURS_RECT       GRect(39, 69, 52, 40)
+#define MINUTES_RECT     GRect(91, 69, 46, 40)
+#define SECONDS_RECT     GRect(137, 69, 25, 25)
+#define COUNTDOWN_RECT   GRect(18, 102, 144, 64)
+
+#define COUNTDOWN_FONT   FONT_KEY_GOTHIC_28_BOLD
+
+#else
+
+#define FACE_RECT        GRect(0, 0, 144, 168)
+#define BACKGROUND_RECT  FACE_RECT
+#define BATTERY_RECT     GRect(121, 0, 22, 10)
+#define BT_RECT          GRect(0, 0, 18, 10)
+#define AMPM_RECT        GRect(0, 98-25, 22, 25)
+#define HOURS_RECT       GRect(21, 63, 52, 40)
+#define MINUTES_RECT     GRect(73, 63, 46, 40)
+#define SECONDS_RECT     GRect(119, 63, 25, 25)
+#define COUNTDOWN_RECT   GRect(0, 96, 144, 72)
+
+#define COUNTDOWN_FONT   FONT_KEY_BITHAM_30_BLACK
+
+#endif
+
+#define TIME_FONT        FONT_KEY_BITHAM_34_MEDIUM_NUMBERS
+#define SECONDS_FONT     FONT_KEY_GOTHIC_24_BOLD
+
+// Aplite's indicators are black on white and ANDed over the background;
+// the colour platforms get a copy of the atlas with transparent white
+// (see tools/make_atlas.py), which GCompOpSet draws over it.
+#if defined(PBL_BW)
+#define INDICATOR_COMPOSITING GCompOpAnd
+#else
+#define INDICATOR_COMPOSITING GCompOpSet
+#endif
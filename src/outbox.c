@@ -0,0 +1,111 @@
+#include <pebble.h>
+#include "outbox.h"
+
+static OutboxWriter writer;
+
+// queue[0] is the message in flight or being retried
+static uint8_t   queue[OUTBOX_QUEUE];
+static uint8_t   queued      = 0;
+static uint8_t   attempts    = 0;
+static bool      in_flight   = false;
+static bool      connected   = true;
+static AppTimer *retry_timer = NULL;
+
+static void pump(void);
+
+static void drop_head(void)
+{
+  --queued;
+  memmove(queue, queue+1, queued);
+  attempts = 0;
+}
+
+static void retry_timer_callback(void *data)
+{
+  retry_timer = NULL;
+  pump();
+}
+
+static void retry(AppMessageResult result)
+{
+  // wait for outbox_connected() rather than spending the attempts
+  if (result == APP_MSG_NOT_CONNECTED) {
+    connected = false;
+    return;
+  }
+  if (++attempts >= OUTBOX_ATTEMPTS) {
+    APP_LOG(APP_LOG_LEVEL_WARNING, "outbox: dropped %d after %d", queue[0], result);
+    drop_head();
+    pump();
+    return;
+  }
+  retry_timer = app_timer_register(OUTBOX_RETRY_MS << (attempts-1), retry_timer_callback, NULL);
+}
+
+static void pump(void)
+{
+  if (!writer || in_flight || retry_timer || !connected || (queued == 0)) return;
+
+  DictionaryIterator *iter;
+  AppMessageResult result = app_message_outbox_begin(&iter);
+  if (result == APP_MSG_OK) {
+    writer(iter, queue[0]);
+    result = app_message_outbox_send();
+  }
+  if (result == APP_MSG_OK)
+    in_flight = true;
+  else
+    retry(result);
+}
+
+static void outbox_sent(DictionaryIterator *iter, void *context)
+{
+  in_flight = false;
+  drop_head();
+  pump();
+}
+
+static void outbox_failed(DictionaryIterator *iter, AppMessageResult reason, void *context)
+{
+  in_flight = false;
+  retry(reason);
+}
+
+void outbox_init(OutboxWriter message_writer)
+{
+  writer = message_writer;
+  app_message_register_outbox_sent(outbox_sent);
+  app_message_register_outbox_failed(outbox_failed);
+  pump();
+}
+
+void outbox_deinit(void)
+{
+  if (retry_timer) app_timer_cancel(retry_timer);
+  retry_timer = NULL;
+  writer = NULL;
+  queued = attempts = 0;
+  in_flight = false;
+}
+
+void outbox_request(uint8_t kind)
+{
+  // the one in flight was written already, so it doesn't count
+  for (uint8_t i = in_flight ? 1 : 0; i < queued; ++i) {
+    if (queue[i] == kind) return;
+  }
+  if (queued == OUTBOX_QUEUE) return;
+  queue[queued++] = kind;
+  pump();
+}
+
+void outbox_connected(bool now_connected)
+{
+  connected = now_connected;
+  if (!connected) return;
+  // start over with whatever was waiting
+  if (retry_timer) app_timer_cancel(retry_timer);
+  retry_timer = NULL;
+  attempts = 0;
+  pump();
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <pebble.h>
+
+// Outbound message pump
+//
+// Messages to the phone are queued as requests, at most one waiting per
+// kind, and sent one at a time.  A message is only written, by the writer
+// given to outbox_init(), as it goes out, so asking again for a kind that
+// is still waiting just merges into it and still sends the latest state.
+// A busy outbox, a NACK or a timeout is retried after OUTBOX_RETRY_MS,
+// doubling each time, and dropped after OUTBOX_ATTEMPTS tries.  While
+// the phone is disconnected nothing is tried until outbox_connected().
+//
+// This takes over the outbox callbacks, so call it after app_sync_init();
+// AppSync only needs them for app_sync_set(), which we don't use.
+
+#define OUTBOX_QUEUE     4
+#define OUTBOX_RETRY_MS  500
+#define OUTBOX_ATTEMPTS  5
+
+typedef void (*OutboxWriter)(DictionaryIterator *iter, uint8_t kind);
+
+void outbox_init(OutboxWriter writer);
+void outbox_deinit(void);
+
+// queue a message of this kind, unless one is already waiting
+void outbox_request(uint8_t kind);
+// from the Bluetooth connection service
+void outbox_connected(bool connected);
@@ -1,47 +1,260 @@
 //  file: pebble-js-app.js
 //  auth: Matthew Clark, SetPebble
 
-// change this token for your project
+// Settings are kept in localStorage under this key, as the JSON object
+// of setting key -> 0/1 the SetPebble page used to send
 var setPebbleToken = 'DMUD';
-// https://dl.dropboxusercontent.com/u/7230515/config.html
+
+// Settings go to the watch as one byte array: the schema version, then one
+// bit per setting key (bit 0 is key 1), least significant byte first.
+// These must match SETTINGS_PACKED_KEY and SETTINGS_SCHEMA in countdown.c;
+// the keys themselves come from eventSettings (js/settings_schema.js,
+// generated from resources/data/events.json).
+var settingsPackedKey = 100;
+var settingsSchema = 1;
+// mask the watch last acknowledged
+var settingsAckedKey = setPebbleToken + '.acked';
+
+// Events are streamed to the watch from eventCatalog (js/event_catalog.js)
+// into its ring of the next few, see src/stream.h.  Every message from
+// the watch carries its cursor: the version it holds events from, the
+// sequence number of the next event it wants and how many it has room
+// for.  We answer with a chunk: our version, the sequence number of its
+// first event, a count and flags, then each event's first day (a local
+// date, days from 1970-01-01), id, length and NUL padded name; all little
+// endian.  Sequence numbers count the events
+// we stream, the enabled ones, so the version covers the settings too and
+// changing them starts the watch over.
+var streamCursorKey = 102;
+var streamChunkKey = 103;
+var streamChunkEvents = 4;
+var streamNameBytes = 24;
+var streamSeqFirst = 0xFFFF;
+var streamLast = 1;
+var streamReset = 2;
+var streamRetries = 2;
+// the watch's ACTION_EVENTS
+var eventsAction = 2;
+
+function loadSettings() {
+  try {
+    var settings = JSON.parse(localStorage.getItem(setPebbleToken));
+    if (settings && typeof(settings) == 'object')
+      return settings;
+  } catch (e) {
+  }
+  return {};
+}
+
+// keys we have no value for stay enabled, like on the watch
+function settingEnabled(settings, key) {
+  return !(key in settings) || settings[key] != 0;
+}
+
+function packSettings(settings) {
+  var packed = [settingsSchema];
+  for (var i = 0; i < Math.ceil(eventSettings.length / 8); ++i)
+    packed.push(0);
+  for (var key = 1; key <= eventSettings.length; ++key) {
+    if (settingEnabled(settings, key))
+      packed[1 + ((key - 1) >> 3)] |= 1 << ((key - 1) & 7);
+  }
+  return packed;
+}
+
+function eventEnabled(settings, id) {
+  for (var i = 0; i < eventSettings.length; ++i) {
+    if (eventSettings[i].id == id)
+      return settingEnabled(settings, eventSettings[i].key);
+  }
+  return true;
+}
+
+function streamedEvents(settings) {
+  return eventCatalog.events.filter(function(event) {
+    return eventEnabled(settings, event[1]);
+  });
+}
+
+function streamVersion(settings) {
+  var version = eventCatalog.version;
+  var packed = packSettings(settings);
+  for (var i = 0; i < packed.length; ++i)
+    version = (version * 31 + packed[i]) >>> 0;
+  return version;
+}
+
+function pushUint(bytes, value, size) {
+  for (var i = 0; i < size; ++i)
+    bytes.push(Math.floor(value / Math.pow(256, i)) & 0xFF);
+}
+
+function readUint(bytes, offset, size) {
+  var value = 0;
+  for (var i = size - 1; i >= 0; --i)
+    value = value * 256 + bytes[offset + i];
+  return value;
+}
+
+// days from 1970-01-01 to the local date at ms, like the catalog's days;
+// the phone's time zone is the watch's
+function localDay(ms) {
+  return Math.floor((ms - new Date(ms).getTimezoneOffset() * 60 * 1000) / (24 * 60 * 60 * 1000));
+}
+
+// the first event not over by today: it runs for length days and is over
+// the day after; once they all are the last one stays, like on the watch
+function firstUpcoming(events, today) {
+  for (var i = 0; i < events.length; ++i) {
+    if (events[i][0] + events[i][2] + 1 > today)
+      return i;
+  }
+  return Math.max(events.length - 1, 0);
+}
+
+// The chunk that follows on from the watch's cursor, or the first one
+// over again if it holds events from another version.  Unless it asked,
+// a watch that is full or has everything gets nothing.
+function sendEvents(cursor, settings, asked, tries) {
+  var version = streamVersion(settings);
+  var events = streamedEvents(settings);
+  var next = readUint(cursor, 4, 2), want = cursor[6];
+  var first = next, flags = 0;
+  if (readUint(cursor, 0, 4) != version || next == streamSeqFirst) {
+    first = firstUpcoming(events, localDay(Date.now()));
+    flags |= streamReset;
+  }
+  var count = Math.max(Math.min(want, streamChunkEvents, events.length - first), 0);
+  if (first + count >= events.length)
+    flags |= streamLast;
+  if (!(flags & streamReset) && count == 0 && !asked)
+    return;
+
+  var chunk = [];
+  pushUint(chunk, version, 4);
+  pushUint(chunk, first, 2);
+  chunk.push(count, flags);
+  for (var i = first; i < first + count; ++i) {
+    var event = events[i];
+    pushUint(chunk, event[0], 4);
+    chunk.push(event[1], event[2]);
+    for (var j = 0; j < streamNameBytes; ++j)
+      chunk.push(j < Math.min(event[3].length, streamNameBytes - 1) ? event[3].charCodeAt(j) & 0x7F : 0);
+  }
+  var message = {};
+  message[streamChunkKey] = chunk;
+  // the next cursor acknowledges it; if it doesn't get there the watch
+  // asks again when it next needs events, but try not to make it wait
+  Pebble.sendAppMessage(message, function(e) {
+  }, function(e) {
+    if (tries < streamRetries)
+      sendEvents(cursor, settings, asked, tries + 1);
+  });
+}
+
+function sendMessage(message, mask) {
+  Pebble.sendAppMessage(message, function(e) {
+    localStorage.setItem(settingsAckedKey, mask);
+  }, function(e) {
+  });
+}
+
+// everything, unless the watch already has it
+function sendSettings(settings) {
+  var packed = packSettings(settings);
+  var mask = packed.join(',');
+  if (mask == localStorage.getItem(settingsAckedKey))
+    return;
+  var message = {};
+  message[settingsPackedKey] = packed;
+  sendMessage(message, mask);
+}
+
+// Apply changes (setting key -> 0/1) and send the watch just those keys,
+// as the per-key tuples it still accepts.  If we don't know the watch
+// has everything else, send it all instead.
+function applyChanges(changes) {
+  var settings = loadSettings();
+  var before = packSettings(settings).join(',');
+  var message = {};
+  var changed = false;
+  for (var key in changes) {
+    var value = changes[key] != 0 ? 1 : 0;
+    if (!(key >= 1 && key <= eventSettings.length) || settingEnabled(settings, key) == (value == 1))
+      continue;
+    settings[key] = value;
+    message[key] = value;
+    changed = true;
+  }
+  if (!changed)
+    return;
+  localStorage.setItem(setPebbleToken, JSON.stringify(settings));
+  if (before == localStorage.getItem(settingsAckedKey))
+    sendMessage(message, packSettings(settings).join(','));
+  else
+    sendSettings(settings);
+}
+
+function escapeHtml(text) {
+  return String(text).replace(/&/g, '&amp;').replace(/</g, '&lt;')
+                     .replace(/>/g, '&gt;').replace(/"/g, '&quot;');
+}
+
+// The configuration page, built here from eventSettings and the stored
+// settings so it opens without the network.  Saving closes it with only
+// the toggles that changed, as {"key": 0/1}.
+function configPage(settings) {
+  var initial = {};
+  var rows = '';
+  for (var i = 0; i < eventSettings.length; ++i) {
+    var event = eventSettings[i];
+    initial[event.key] = settingEnabled(settings, event.key) ? 1 : 0;
+    rows += '<label><input type="checkbox" id="k' + event.key + '"' +
+            (initial[event.key] ? ' checked' : '') + '> ' + escapeHtml(event.title) + '</label>';
+  }
+  var script =
+    'var initial=' + JSON.stringify(initial) + ';' +
+    'function save(){var d={},n=0;for(var k in initial){' +
+    'var v=document.getElementById("k"+k).checked?1:0;' +
+    'if(v!=initial[k]){d[k]=v;++n;}}' +
+    'location.href="pebblejs://close#"+(n?encodeURIComponent(JSON.stringify(d)):"");}' +
+    'function cancel(){location.href="pebblejs://close#";}';
+  var html =
+    '<!DOCTYPE html><html><head><meta charset="utf-8">' +
+    '<meta name="viewport" content="width=device-width,initial-scale=1">' +
+    '<title>MINI Countdown</title><style>' +
+    'body{font-family:sans-serif;margin:0 1em}label{display:block;padding:.6em 0;' +
+    'border-bottom:1px solid #ddd}button{width:48%;padding:.8em;margin:1em 1% 0}' +
+    '</style></head><body><h3>Count down to</h3>' + rows +
+    '<button onclick="cancel()">Cancel</button><button onclick="save()">Save</button>' +
+    '<script>' + script + '</script></body></html>';
+  // the Android app wants a URL that ends in .html
+  return 'data:text/html;charset=utf-8,' + encodeURIComponent(html) + '<!--.html';
+}
 
 Pebble.addEventListener('ready', function(e) {
 });
 Pebble.addEventListener('appmessage', function(e) {
-  key = e.payload.action;
-  if (typeof(key) != 'undefined') {
-    var settings = localStorage.getItem(setPebbleToken);
-    if (typeof(settings) == 'string') {
-      try {
-        Pebble.sendAppMessage(JSON.parse(settings));
-      } catch (e) {
-      }
-    }
-    var request = new XMLHttpRequest();
-    request.open('GET', 'http://x.SetPebble.com/api/' + setPebbleToken + '/' + Pebble.getAccountToken(), true);
-    //request.open('GET', 'http://x.SetPebble.com/api/' + setPebbleToken + '/' + '50ba8d83-11a3-4846-a34d-ff428b06f8de', true);
-    
-    request.onload = function(e) {
-      if (request.readyState == 4)
-        if (request.status == 200)
-          try {
-            Pebble.sendAppMessage(JSON.parse(request.responseText));
-          } catch (e) {
-          }
-    }
-    request.send(null);
-  }
+  // the watch tells us what it has whenever it asks for settings
+  var current = e.payload[settingsPackedKey];
+  if (current instanceof Array)
+    localStorage.setItem(settingsAckedKey, current.join(','));
+  if (typeof(e.payload.action) != 'undefined')
+    sendSettings(loadSettings());
+  // and whatever it asked, top up its events
+  var cursor = e.payload[streamCursorKey];
+  if (cursor instanceof Array && cursor.length >= 7)
+    sendEvents(cursor, loadSettings(), e.payload.action == eventsAction, 0);
 });
+
 Pebble.addEventListener('showConfiguration', function(e) {
-  Pebble.openURL('http://x.SetPebble.com/' + setPebbleToken + '/' + Pebble.getAccountToken());
-  //Pebble.openURL('https://dl.dropboxusercontent.com/u/7230515/config.html');
+  Pebble.openURL(configPage(loadSettings()));
 });
 Pebble.addEventListener('webviewclosed', function(e) {
   if ((typeof(e.response) == 'string') && (e.response.length > 0)) {
     try {
-      Pebble.sendAppMessage(JSON.parse(e.response));
-      localStorage.setItem(setPebbleToken, e.response);
+      applyChanges(JSON.parse(decodeURIComponent(e.response)));
     } catch(e) {
     }
   }
-});
\ No newline at end of file
+});
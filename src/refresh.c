@@ -0,0 +1,129 @@
+#include <pebble.h>
+#include "refresh.h"
+
+static RefreshConfig      config;
+static TickHandler        tick_handler;
+static RefreshModeHandler mode_handler;
+
+static TimeUnits current_units = 0;
+static bool      battery_low   = false;
+static bool      bt_connected  = true;
+static AppTimer *tap_timer     = NULL;
+static bool      idle          = false;
+// minute ticks since the last tap
+static uint16_t  still_minutes = 0;
+
+static uint32_t  wakeups_avoided = 0;
+
+static TimeUnits wanted_units()
+{
+  if (tap_timer) return SECOND_UNIT;
+  if (idle) return MINUTE_UNIT;
+  if (battery_low) return MINUTE_UNIT;
+  if (!bt_connected && config.slow_when_disconnected) return MINUTE_UNIT;
+  return SECOND_UNIT;
+}
+
+static void apply_policy(void);
+
+static bool wants_taps()
+{
+  return (config.tap_wake_seconds > 0) || (config.idle_minutes > 0) || config.tap_observer;
+}
+
+static void refresh_tick(struct tm *tick_time, TimeUnits units_changed)
+{
+  if (units_changed & DAY_UNIT) wakeups_avoided = 0;
+  // a minute tick stands in for 60 second ticks
+  if (current_units == MINUTE_UNIT) wakeups_avoided += 59;
+
+  tick_handler(tick_time, units_changed);
+
+  if ((units_changed & MINUTE_UNIT) && (config.idle_minutes > 0) && !idle &&
+      (++still_minutes >= config.idle_minutes)) {
+    idle = true;
+    apply_policy();
+  }
+}
+
+static void apply_policy()
+{
+  TimeUnits units = wanted_units();
+  if (units == current_units) return;
+
+  current_units = units;
+  tick_timer_service_subscribe(units, refresh_tick);
+  if (mode_handler) mode_handler(units);
+}
+
+static void tap_expired(void *data)
+{
+  tap_timer = NULL;
+  apply_policy();
+}
+
+static void handle_tap(AccelAxisType axis, int32_t direction)
+{
+  if (config.tap_observer) config.tap_observer(axis, direction);
+  still_minutes = 0;
+  if (idle) {
+    idle = false;
+    apply_policy();
+  }
+  if (config.tap_wake_seconds == 0) return;
+
+  if (tap_timer) {
+    app_timer_reschedule(tap_timer, config.tap_wake_seconds * 1000);
+  } else if (current_units != SECOND_UNIT) {
+    // only worth a timer when the tap actually changes something
+    tap_timer = app_timer_register(config.tap_wake_seconds * 1000, tap_expired, NULL);
+    apply_policy();
+  }
+}
+
+void refresh_init(const RefreshConfig *cfg, TickHandler handler, RefreshModeHandler mode_changed)
+{
+  config       = *cfg;
+  tick_handler = handler;
+  mode_handler = mode_changed;
+
+  current_units = 0;
+  idle          = false;
+  still_minutes = 0;
+  apply_policy();
+
+  if (wants_taps()) accel_tap_service_subscribe(handle_tap);
+}
+
+void refresh_deinit()
+{
+  if (wants_taps()) accel_tap_service_unsubscribe();
+  if (tap_timer) {
+    app_timer_cancel(tap_timer);
+    tap_timer = NULL;
+  }
+  tick_timer_service_unsubscribe();
+}
+
+void refresh_battery(BatteryChargeState charge_state)
+{
+  battery_low = !charge_state.is_charging && !charge_state.is_plugged &&
+                (charge_state.charge_percent <= config.low_battery_percent);
+  apply_policy();
+}
+
+void refresh_bluetooth(bool connected)
+{
+  bt_connected = connected;
+  apply_policy();
+}
+
+TimeUnits refresh_units()
+{
+  return current_units;
+}
+
+uint32_t refresh_wakeups_avoided()
+{
+  return wakeups_avoided;
+}
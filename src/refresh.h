@@ -0,0 +1,39 @@
+#pragma once
+
+#include <pebble.h>
+
+// Adaptive refresh policy
+//
+// Decides whether the face ticks every second or every minute.  Per-second
+// wakeups are the biggest battery cost, so we drop to MINUTE_UNIT when the
+// battery is low, the phone is gone or no tap has come for a while (the
+// watch is idle, nobody is looking at it), and come back to SECOND_UNIT
+// for a short while after a wrist tap.
+
+typedef struct {
+  // at or below this charge (and not on the charger) tick once a minute
+  uint8_t  low_battery_percent;
+  // tick once a minute while Bluetooth is disconnected
+  bool     slow_when_disconnected;
+  // seconds of SECOND_UNIT ticking after a tap, 0 disables tap wake
+  uint16_t tap_wake_seconds;
+  // tick once a minute after this many minutes without a tap, until the
+  // next one; 0 never counts the watch idle
+  uint16_t idle_minutes;
+  // also told about every tap, may be NULL
+  AccelTapHandler tap_observer;
+} RefreshConfig;
+
+// called whenever the tick unit changes so the face can hide/show seconds
+typedef void (*RefreshModeHandler)(TimeUnits units);
+
+void      refresh_init(const RefreshConfig *config, TickHandler handler, RefreshModeHandler mode_changed);
+void      refresh_deinit(void);
+
+// inputs from the battery and Bluetooth services
+void      refresh_battery(BatteryChargeState charge_state);
+void      refresh_bluetooth(bool connected);
+
+TimeUnits refresh_units(void);
+// second ticks not taken since local midnight
+uint32_t  refresh_wakeups_avoided(void);
@@ -0,0 +1,92 @@
+#include <pebble.h>
+#include "settings.h"
+#include "stats.h"
+
+#define SETTINGS_KEY     1
+#define SETTINGS_VERSION 1
+
+// before version 1 each event had its own bool at this offset + id
+#define LEGACY_KEY_OFFSET 64
+
+typedef struct {
+  uint8_t version;
+  // one bit per event id, set means disabled
+  uint8_t disabled[256/8];
+} StoredSettings;
+
+static StoredSettings settings;
+static bool           dirty = false;
+static bool           loaded = false;
+// the old per-event keys are still to be picked up
+static bool           migrate = false;
+
+void settings_init()
+{
+  if (loaded) return;
+  loaded = true;
+  int read = persist_read_data(SETTINGS_KEY, &settings, sizeof(settings));
+  STATS_INC(stat_persist_read);
+  if ((read == (int)sizeof(settings)) && (settings.version == SETTINGS_VERSION)) {
+    dirty = false;
+    return;
+  }
+
+  // first run of this version; the old keys are picked up later, by
+  // settings_migrate()
+  memset(&settings, 0, sizeof(settings));
+  settings.version = SETTINGS_VERSION;
+  dirty = true;
+  migrate = true;
+}
+
+bool settings_migrate(const uint8_t *ids, size_t count)
+{
+  if (!migrate) return false;
+  migrate = false;
+
+  //APP_LOG(APP_LOG_LEVEL_DEBUG, "Migrating per-event settings");
+  bool changed = false;
+  uint8_t found[256/8] = { 0 };
+  for (size_t i = 0; i < count; ++i) {
+    uint32_t storage_key = LEGACY_KEY_OFFSET + ids[i];
+    if (persist_exists(storage_key)) {
+      STATS_INC(stat_persist_read);
+      if (settings_set_enabled(ids[i], persist_read_bool(storage_key))) changed = true;
+      found[ids[i]/8] |= (1 << (ids[i]%8));
+    }
+  }
+
+  // only drop the old keys once the new one is safely written
+  settings_flush();
+  if (dirty) return changed;
+  for (unsigned int id = 0; id < 256; ++id) {
+    if (found[id/8] & (1 << (id%8))) persist_delete(LEGACY_KEY_OFFSET + id);
+  }
+  return changed;
+}
+
+void settings_flush()
+{
+  if (!dirty) return;
+  STATS_INC(stat_persist_write);
+  if (persist_write_data(SETTINGS_KEY, &settings, sizeof(settings)) == (int)sizeof(settings))
+    dirty = false;
+}
+
+bool settings_enabled(uint8_t id)
+{
+  if (!loaded) settings_init();
+  return (settings.disabled[id/8] & (1 << (id%8))) == 0;
+}
+
+bool settings_set_enabled(uint8_t id, bool enable)
+{
+  if (settings_enabled(id) == enable) return false;
+
+  if (enable)
+    settings.disabled[id/8] &= ~(1 << (id%8));
+  else
+    settings.disabled[id/8] |= (1 << (id%8));
+  dirty = true;
+  return true;
+}
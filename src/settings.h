@@ -0,0 +1,24 @@
+#pragma once
+
+#include <pebble.h>
+
+// Settings store
+//
+// Every event's enabled flag lives in one bitset, indexed by event id,
+// stored under a single versioned persist key.  It is read once, the
+// first time a setting is looked at, changed in RAM, and written back
+// only when something changed.  Events start out enabled.
+
+// reads the store now rather than on first use
+void settings_init(void);
+// writes the bitset back if anything changed since it was read
+void settings_flush(void);
+// On the first run of this version, picks up the per-event keys older
+// versions kept for the count ids given, writes the store and drops them.
+// Does nothing otherwise, or if the store was never read.  Returns true if
+// it changed a setting.
+bool settings_migrate(const uint8_t *ids, size_t count);
+
+bool settings_enabled(uint8_t id);
+// returns true if this changed the setting
+bool settings_set_enabled(uint8_t id, bool enable);
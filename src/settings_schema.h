@@ -0,0 +1,47 @@
+#pragma once
+
+// Event settings: configuration page/AppSync key, name and event id.
+// Generated by tools/make_catalog.py from resources/data/events.json,
+// do not edit.
+
+enum Settings {
+  setting_MOTD  =  1,
+  setting_AMVIV =  2,
+  setting_MOT   =  3,
+  setting_MME   =  4,
+  setting_MACK  =  5,
+  setting_MITM  =  6,
+  setting_MandM =  7,
+  setting_MiF   =  8,
+  setting_MSSD  =  9,
+  setting_MITO  = 10,
+  setting_count
+};
+
+// event id each setting turns on and off
+static const uint8_t setting_event_id[setting_count] = {
+  [setting_MOTD]  =   1,
+  [setting_AMVIV] =   2,
+  [setting_MOT]   =   3,
+  [setting_MME]   =   4,
+  [setting_MACK]  =   5,
+  [setting_MITM]  =   6,
+  [setting_MandM] =   7,
+  [setting_MiF]   =   8,
+  [setting_MSSD]  =   9,
+  [setting_MITO]  =  10,
+};
+
+// AppSync initial tuples, one per setting; enabled(key) gives the
+// current value
+#define SETTINGS_TUPLETS(enabled) \
+  TupletInteger(setting_MOTD,  enabled(setting_MOTD)), \
+  TupletInteger(setting_AMVIV, enabled(setting_AMVIV)), \
+  TupletInteger(setting_MOT,   enabled(setting_MOT)), \
+  TupletInteger(setting_MME,   enabled(setting_MME)), \
+  TupletInteger(setting_MACK,  enabled(setting_MACK)), \
+  TupletInteger(setting_MITM,  enabled(setting_MITM)), \
+  TupletInteger(setting_MandM, enabled(setting_MandM)), \
+  TupletInteger(setting_MiF,   enabled(setting_MiF)), \
+  TupletInteger(setting_MSSD,  enabled(setting_MSSD)), \
+  TupletInteger(setting_MITO,  enabled(setting_MITO)),
@@ -0,0 +1,141 @@
+#include <pebble.h>
+#include "stats.h"
+#include "refresh.h"
+
+#if STATS_ENABLED
+
+// three taps within this long toggle the overlay
+#define STATS_TAP_WINDOW_MS  2000
+#define STATS_TAP_COUNT      3
+// and it goes away again by itself after this long
+#define STATS_OVERLAY_MS     (30*1000)
+
+uint32_t stats_counters[stat_count];
+
+static size_t heap_used_max;
+static size_t heap_free_min;
+
+static time_t   started_s;
+static uint16_t started_ms;
+// 0 until the stage is done
+static uint16_t startup_ms[stage_count];
+
+static StatsOverlayHandler overlay_handler;
+static bool      overlay_shown = false;
+static AppTimer *overlay_timer = NULL;
+static AppTimer *tap_timer     = NULL;
+static uint8_t   taps          = 0;
+
+void stats_init(StatsOverlayHandler overlay_changed)
+{
+  memset(stats_counters, 0, sizeof(stats_counters));
+  overlay_handler = overlay_changed;
+  heap_used_max = 0;
+  heap_free_min = (size_t)-1;
+  stats_sample_heap();
+  memset(startup_ms, 0, sizeof(startup_ms));
+  time_ms(&started_s, &started_ms);
+}
+
+void stats_deinit()
+{
+  if (overlay_timer) app_timer_cancel(overlay_timer);
+  if (tap_timer) app_timer_cancel(tap_timer);
+  overlay_timer = NULL;
+  tap_timer = NULL;
+}
+
+void stats_sample_heap()
+{
+  size_t used = heap_bytes_used();
+  size_t available = heap_bytes_free();
+  if (used > heap_used_max) heap_used_max = used;
+  if (available < heap_free_min) heap_free_min = available;
+}
+
+void stats_startup(StartupStage stage)
+{
+  if (startup_ms[stage] != 0) return;
+
+  time_t s;
+  uint16_t ms;
+  time_ms(&s, &ms);
+  int32_t elapsed = (int32_t)(s - started_s)*1000 + ms - started_ms;
+  // keep 0 for "not yet"
+  startup_ms[stage] = (elapsed > 0) ? ((elapsed < 0xFFFF) ? elapsed : 0xFFFF) : 1;
+  APP_LOG(APP_LOG_LEVEL_INFO, "startup stage %d done at %d ms", (int)stage, (int)startup_ms[stage]);
+}
+
+// uint32_t is unsigned long on the watch but not everywhere
+#define STAT(stat) ((unsigned long)stats_counters[(stat)])
+
+void stats_format(char *buffer, size_t size)
+{
+  snprintf(buffer, size,
+           "tick s%lu m%lu h%lu d%lu skip %lu\n"
+           "draw %lu full %lu sec %lu\n"
+           "ev %lu p r%lu w%lu sync %lu\n"
+           "heap max %u min free %u\n"
+           "start %u/%u/%u/%u ms",
+           STAT(stat_tick_second), STAT(stat_tick_minute), STAT(stat_tick_hour), STAT(stat_tick_day),
+           (unsigned long)refresh_wakeups_avoided(),
+           STAT(stat_mark_dirty), STAT(stat_frame_full), STAT(stat_frame_seconds),
+           STAT(stat_choose_event), STAT(stat_persist_read), STAT(stat_persist_write),
+           STAT(stat_sync_callback),
+           (unsigned int)heap_used_max, (unsigned int)heap_free_min,
+           startup_ms[stage_face], startup_ms[stage_first_frame],
+           startup_ms[stage_indicators], startup_ms[stage_sync]);
+}
+
+void stats_tick(TimeUnits units_changed)
+{
+  if (units_changed & SECOND_UNIT) ++stats_counters[stat_tick_second];
+  if (units_changed & MINUTE_UNIT) ++stats_counters[stat_tick_minute];
+  if (units_changed & DAY_UNIT) ++stats_counters[stat_tick_day];
+  if (units_changed & HOUR_UNIT) {
+    ++stats_counters[stat_tick_hour];
+    char summary[160];
+    stats_format(summary, sizeof(summary));
+    APP_LOG(APP_LOG_LEVEL_INFO, "stats: %s", summary);
+  }
+}
+
+static void set_overlay(bool shown)
+{
+  if (overlay_timer) {
+    app_timer_cancel(overlay_timer);
+    overlay_timer = NULL;
+  }
+  overlay_shown = shown;
+  if (overlay_handler) overlay_handler(shown);
+}
+
+static void overlay_expired(void *data)
+{
+  overlay_timer = NULL;
+  set_overlay(false);
+}
+
+static void tap_window_expired(void *data)
+{
+  tap_timer = NULL;
+  taps = 0;
+}
+
+void stats_tap(AccelAxisType axis, int32_t direction)
+{
+  if (!tap_timer) tap_timer = app_timer_register(STATS_TAP_WINDOW_MS, tap_window_expired, NULL);
+  if (++taps < STATS_TAP_COUNT) return;
+
+  app_timer_cancel(tap_timer);
+  tap_window_expired(NULL);
+  set_overlay(!overlay_shown);
+  if (overlay_shown) overlay_timer = app_timer_register(STATS_OVERLAY_MS, overlay_expired, NULL);
+}
+
+bool stats_overlay_shown()
+{
+  return overlay_shown;
+}
+
+#endif
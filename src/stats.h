@@ -0,0 +1,77 @@
+#pragma once
+
+#include <pebble.h>
+
+// Performance counters
+//
+// Counts what the face does in the field: ticks by unit, second ticks
+// the refresh policy skipped today, frames, event lookups, persistent
+// storage traffic, AppSync callbacks, the heap high-water mark and how
+// long each startup stage took.  A summary goes
+// to the log every hour, and a triple wrist flick shows it over the
+// countdown.  Off by default, so every STATS_* macro compiles to nothing;
+// `./waf configure --stats` (or STATS_ENABLED 1) builds them in.
+
+#ifndef STATS_ENABLED
+#define STATS_ENABLED 0
+#endif
+
+typedef enum {
+  stat_tick_second = 0,
+  stat_tick_minute,
+  stat_tick_hour,
+  stat_tick_day,
+  stat_mark_dirty,
+  stat_frame_full,
+  stat_frame_seconds,
+  stat_choose_event,
+  stat_persist_read,
+  stat_persist_write,
+  stat_sync_callback,
+  stat_count
+} Stat;
+
+// startup stages, in the order they finish (see handle_init)
+typedef enum {
+  stage_face = 0,
+  stage_first_frame,
+  stage_indicators,
+  stage_sync,
+  stage_count
+} StartupStage;
+
+// called when the overlay is shown or hidden so the face can redraw
+typedef void (*StatsOverlayHandler)(bool shown);
+
+#if STATS_ENABLED
+
+extern uint32_t stats_counters[stat_count];
+
+#define STATS_INC(stat)               (++stats_counters[(stat)])
+#define STATS_TICK(units)             stats_tick(units)
+#define STATS_HEAP()                  stats_sample_heap()
+#define STATS_OVERLAY_SHOWN()         stats_overlay_shown()
+#define STATS_STARTUP(stage)          stats_startup(stage)
+
+void stats_init(StatsOverlayHandler overlay_changed);
+void stats_deinit(void);
+// count a tick; logs the summary on the hour
+void stats_tick(TimeUnits units_changed);
+void stats_sample_heap(void);
+// milliseconds from stats_init() to the end of stage, first time only
+void stats_startup(StartupStage stage);
+// feed every accelerometer tap here, three in a row toggle the overlay
+void stats_tap(AccelAxisType axis, int32_t direction);
+bool stats_overlay_shown(void);
+// the summary as shown in the overlay
+void stats_format(char *buffer, size_t size);
+
+#else
+
+#define STATS_INC(stat)               ((void)0)
+#define STATS_TICK(units)             ((void)0)
+#define STATS_HEAP()                  ((void)0)
+#define STATS_OVERLAY_SHOWN()         false
+#define STATS_STARTUP(stage)          ((void)0)
+
+#endif
@@ -0,0 +1,211 @@
+#include <pebble.h>
+#include "stream.h"
+#include "stats.h"
+
+#define STREAM_KEY       4
+// and the keys after it, one per page
+#define STREAM_PAGE_KEY  5
+#define STREAM_VERSION   2
+
+// slots are persisted a page of them to a key
+#define PAGE_EVENTS      8
+#define PAGES            ((STREAM_EVENTS + PAGE_EVENTS - 1) / PAGE_EVENTS)
+
+// a record's name field for the placeholder at index 0
+#define PLACEHOLDER_NAME 0xFFFF
+
+_Static_assert(PAGE_EVENTS*sizeof(StreamEvent) <= PERSIST_DATA_MAX_LENGTH, "page does not fit a persist key");
+_Static_assert(STREAM_CHUNK <= STREAM_EVENTS, "chunk does not fit the ring");
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t  version;
+  // slot of the oldest event held, and how many there are
+  uint8_t  head;
+  uint8_t  count;
+  // STREAM_LAST once the phone has sent its last event
+  uint8_t  flags;
+  // the phone's version the events came from
+  uint32_t catalog;
+  // sequence number of the oldest event held
+  uint16_t first;
+  // bumped whenever the events held change
+  uint32_t changes;
+} StreamHeader;
+
+static StreamHeader header;
+static StreamEvent  slots[PAGES*PAGE_EVENTS];
+static bool         loaded       = false;
+static bool         header_dirty = false;
+static uint8_t      dirty_pages  = 0;
+
+_Static_assert(PAGES <= 8, "dirty_pages has a bit per page");
+
+static void forget(void)
+{
+  memset(&header, 0, sizeof(header));
+  header.version = STREAM_VERSION;
+}
+
+static void load_pages(void)
+{
+  // only the pages holding events are sure to have been written
+  uint8_t wanted = 0;
+  for (uint8_t n = 0; n < header.count; ++n)
+    wanted |= 1 << (((header.head + n) % STREAM_EVENTS) / PAGE_EVENTS);
+
+  loaded = true;
+  for (unsigned int page = 0; page < PAGES; ++page) {
+    if (!(wanted & (1 << page))) continue;
+    int read = persist_read_data(STREAM_PAGE_KEY + page, &slots[page*PAGE_EVENTS], PAGE_EVENTS*sizeof(StreamEvent));
+    STATS_INC(stat_persist_read);
+    if (read != (int)(PAGE_EVENTS*sizeof(StreamEvent))) {
+      // ask for them all again
+      APP_LOG(APP_LOG_LEVEL_WARNING, "stream: lost page %d", page);
+      forget();
+      header_dirty = true;
+      break;
+    }
+  }
+}
+
+static StreamEvent *held(uint16_t n)
+{
+  if (!loaded) load_pages();
+  return &slots[(header.head + n) % STREAM_EVENTS];
+}
+
+void stream_init()
+{
+  int read = persist_read_data(STREAM_KEY, &header, sizeof(header));
+  STATS_INC(stat_persist_read);
+  if ((read != (int)sizeof(header)) || (header.version != STREAM_VERSION) ||
+      (header.head >= STREAM_EVENTS) || (header.count > STREAM_EVENTS))
+    forget();
+  loaded = false;
+  header_dirty = false;
+  dirty_pages = 0;
+}
+
+void stream_flush()
+{
+  for (unsigned int page = 0; page < PAGES; ++page) {
+    if (!(dirty_pages & (1 << page))) continue;
+    STATS_INC(stat_persist_write);
+    if (persist_write_data(STREAM_PAGE_KEY + page, &slots[page*PAGE_EVENTS], PAGE_EVENTS*sizeof(StreamEvent)) ==
+        (int)(PAGE_EVENTS*sizeof(StreamEvent)))
+      dirty_pages &= ~(1 << page);
+  }
+  // after the pages, so it never points at events that weren't written
+  if (!header_dirty || dirty_pages) return;
+  STATS_INC(stat_persist_write);
+  if (persist_write_data(STREAM_KEY, &header, sizeof(header)) == (int)sizeof(header))
+    header_dirty = false;
+}
+
+bool stream_active()
+{
+  return header.count > 0;
+}
+
+uint16_t stream_count()
+{
+  return header.count ? header.count + 1 : 0;
+}
+
+uint32_t stream_version()
+{
+  return header.catalog + header.changes;
+}
+
+bool stream_read(uint16_t index, CatalogRecord *record)
+{
+  if (index == 0) {
+    *record = (CatalogRecord){ .day = 0, .id = 0, .length = 0, .name = PLACEHOLDER_NAME };
+    return true;
+  }
+  if (index > header.count) return false;
+  const StreamEvent *event = held(index-1);
+  *record = (CatalogRecord){
+    .day    = event->day,
+    .id     = event->id,
+    .length = event->length,
+    .name   = index-1,
+  };
+  return true;
+}
+
+void stream_read_name(const CatalogRecord *record, char *buffer, size_t size)
+{
+  buffer[0] = '\0';
+  if (record->name >= header.count) return;
+  strncpy(buffer, held(record->name)->name, size-1);
+  buffer[size-1] = '\0';
+}
+
+bool stream_drop(uint16_t index)
+{
+  if ((index < 2) || (header.count == 0)) return false;
+  uint16_t over = index-1;
+  if (over > header.count-1) over = header.count-1;
+  if (over == 0) return false;
+
+  header.head   = (header.head + over) % STREAM_EVENTS;
+  header.count -= over;
+  header.first += over;
+  ++header.changes;
+  header_dirty = true;
+  return true;
+}
+
+bool stream_wants_more()
+{
+  return (header.count > 0) && !(header.flags & STREAM_LAST) &&
+         (STREAM_EVENTS - header.count >= STREAM_CHUNK);
+}
+
+void stream_cursor(StreamCursor *cursor)
+{
+  cursor->version = header.catalog;
+  cursor->next    = header.count ? header.first + header.count : STREAM_SEQ_FIRST;
+  cursor->want    = STREAM_EVENTS - header.count;
+}
+
+bool stream_receive(const uint8_t *data, uint16_t length)
+{
+  StreamChunkHeader chunk;
+  if (length < sizeof(chunk)) return false;
+  memcpy(&chunk, data, sizeof(chunk));
+  if ((chunk.count > STREAM_CHUNK) || (length < sizeof(chunk) + chunk.count*sizeof(StreamEvent)))
+    return false;
+
+  if (chunk.flags & STREAM_RESET) {
+    // a repeat of the reset we already started from
+    if (header.count && (chunk.version == header.catalog) && (chunk.first == header.first)) return false;
+    header.catalog = chunk.version;
+    header.first   = chunk.first;
+    header.head    = 0;
+    header.count   = 0;
+    loaded = true;
+  } else if ((header.count == 0) || (chunk.version != header.catalog) ||
+             (chunk.first != (uint16_t)(header.first + header.count))) {
+    // not what we asked for; the next request says so
+    return false;
+  }
+
+  const StreamEvent *events = (const StreamEvent *)(data + sizeof(chunk));
+  uint8_t added = 0;
+  for (; (added < chunk.count) && (header.count < STREAM_EVENTS); ++added) {
+    StreamEvent *event = held(header.count);
+    memcpy(event, &events[added], sizeof(*event));
+    event->name[STREAM_NAME-1] = '\0';
+    dirty_pages |= 1 << ((event - slots) / PAGE_EVENTS);
+    ++header.count;
+  }
+  // if we had no room for all of it the rest is asked for again
+  uint8_t flags = (added == chunk.count) ? (chunk.flags & STREAM_LAST) : 0;
+  if ((added == 0) && (flags == header.flags) && !(chunk.flags & STREAM_RESET)) return false;
+  header.flags = flags;
+  ++header.changes;
+  header_dirty = true;
+  return true;
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <pebble.h>
+#include "catalog.h"
+
+// Streamed events
+//
+// The companion keeps the whole event catalog and streams the next few
+// upcoming events to the watch, at most STREAM_CHUNK a message, into a
+// ring of STREAM_EVENTS slots that is persisted across restarts.  Watch
+// memory is the same however long the catalog is.  Once anything has
+// been streamed the ring stands in for the EVENT_CATALOG resource (see
+// catalog.c): index 0 is a placeholder before the events, like the
+// resource's DUMMY record, and the events held follow, oldest first.
+//
+// Every message the watch sends carries a StreamCursor: the phone's
+// catalog version the ring was filled from, the sequence number of the
+// next event wanted and the free slots.  A chunk has to start at that
+// sequence number, so each request also acknowledges the chunk before it;
+// one that doesn't follow on from what we hold is ignored and the next
+// request asks again.  When the phone's catalog (or which events it
+// streams) changes it answers with a STREAM_RESET chunk and the ring
+// starts over.  Events that are over are dropped to make room.
+
+#define STREAM_EVENTS     16
+#define STREAM_CHUNK      4
+// name bytes, NUL included
+#define STREAM_NAME       24
+
+// asked for while we hold nothing: the phone starts at its first event
+// that isn't over
+#define STREAM_SEQ_FIRST  0xFFFF
+
+// chunk flags
+#define STREAM_LAST       0x01
+#define STREAM_RESET      0x02
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t version;
+  uint16_t next;
+  uint8_t  want;
+} StreamCursor;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t version;
+  uint16_t first;
+  uint8_t  count;
+  uint8_t  flags;
+} StreamChunkHeader;
+
+// as in the catalog, see CatalogRecord
+typedef struct __attribute__((__packed__)) {
+  uint32_t day;
+  uint8_t  id;
+  uint8_t  length;
+  char     name[STREAM_NAME];
+} StreamEvent;
+
+// the biggest chunk the phone sends
+#define STREAM_CHUNK_SIZE (sizeof(StreamChunkHeader) + STREAM_CHUNK*sizeof(StreamEvent))
+
+// reads what was held at the last exit; the events themselves are read
+// the first time they are needed
+void     stream_init(void);
+// writes back whatever changed
+void     stream_flush(void);
+
+// true while the ring holds any events
+bool     stream_active(void);
+// placeholder included, like catalog_count()
+uint16_t stream_count(void);
+// changes whenever the events held do
+uint32_t stream_version(void);
+bool     stream_read(uint16_t index, CatalogRecord *record);
+void     stream_read_name(const CatalogRecord *record, char *buffer, size_t size);
+
+// the events before index are over; drops them, keeping the last one
+// held, and returns true if any went
+bool     stream_drop(uint16_t index);
+// true when there is room for another chunk and the phone may have one
+bool     stream_wants_more(void);
+
+void     stream_cursor(StreamCursor *cursor);
+// a chunk from the phone; true if it changed the events held
+bool     stream_receive(const uint8_t *data, uint16_t length);
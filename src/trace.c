@@ -0,0 +1,61 @@
+#include <pebble.h>
+#include "stats.h"
+#include "trace.h"
+
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+
+_Static_assert(sizeof(TraceRing) <= PERSIST_DATA_MAX_LENGTH, "trace ring does not fit a persist key");
+_Static_assert(trace_event_count <= 256, "trace events are stored in a byte");
+
+// ring bytes per log line
+#define TRACE_DUMP_LINE 32
+
+static TraceRing ring;
+
+void trace_init()
+{
+  int read = persist_read_data(TRACE_KEY, &ring, sizeof(ring));
+  STATS_INC(stat_persist_read);
+  if ((read != (int)sizeof(ring)) || (ring.version != TRACE_VERSION) ||
+      (ring.head >= TRACE_RECORDS) || (ring.count > TRACE_RECORDS)) {
+    memset(&ring, 0, sizeof(ring));
+    ring.version = TRACE_VERSION;
+  }
+  ring.level = TRACE_LEVEL;
+  trace_record(trace_start, TRACE_LEVEL, TRACE_RECORDS);
+}
+
+void trace_flush()
+{
+  trace_record(trace_stop, 0, 0);
+  STATS_INC(stat_persist_write);
+  persist_write_data(TRACE_KEY, &ring, sizeof(ring));
+}
+
+// "trace <line>/<lines> <hex>", see tools/decode_trace.py
+void trace_dump()
+{
+  static const char hex[] = "0123456789abcdef";
+  const uint8_t *bytes = (const uint8_t *)&ring;
+  unsigned int lines = (sizeof(ring) + TRACE_DUMP_LINE-1) / TRACE_DUMP_LINE;
+
+  for (unsigned int line = 0; line < lines; ++line) {
+    char text[2*TRACE_DUMP_LINE + 1];
+    unsigned int n = 0;
+    for (unsigned int i = line*TRACE_DUMP_LINE; (i < sizeof(ring)) && (i < (line+1)*TRACE_DUMP_LINE); ++i) {
+      text[n++] = hex[bytes[i] >> 4];
+      text[n++] = hex[bytes[i] & 0xF];
+    }
+    text[n] = '\0';
+    APP_LOG(APP_LOG_LEVEL_INFO, "trace %d/%d %s", (int)line+1, (int)lines, text);
+  }
+}
+
+void trace_record(TraceEvent event, uint8_t a, uint16_t b)
+{
+  ring.records[ring.head] = (TraceRecord){ time(NULL), event, a, b };
+  if (++ring.head == TRACE_RECORDS) ring.head = 0;
+  if (ring.count < TRACE_RECORDS) ++ring.count;
+}
+
+#endif
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <pebble.h>
+
+// Trace ring
+//
+// Post-mortem record of what the face did: each TRACE_* call below
+// writes an 8-byte record (watch time, event, two small arguments) into a
+// RAM ring of the last TRACE_RECORDS, with no formatting and no logging.
+// The ring is read back at startup, so it carries on across runs, and
+// written to persist on exit.  Once per launch, after the face is up, it
+// is also logged as hex; tools/decode_trace.py turns those log lines (or
+// the raw persisted bytes) back into a timeline.
+//
+// TRACE_LEVEL picks what is recorded: TRACE_LEVEL_EVENTS for event
+// choice, settings, sync, battery and Bluetooth, TRACE_LEVEL_TICKS for
+// every tick on top.  At TRACE_LEVEL_OFF, the default, every TRACE_*
+// macro compiles to nothing.
+
+#define TRACE_LEVEL_OFF     0
+#define TRACE_LEVEL_EVENTS  1
+#define TRACE_LEVEL_TICKS   2
+
+#ifndef TRACE_LEVEL
+#define TRACE_LEVEL TRACE_LEVEL_OFF
+#endif
+
+#define TRACE_KEY      7
+#define TRACE_VERSION  1
+// as many as fit one persist key with the header
+#define TRACE_RECORDS  31
+
+// Event ids are stored, so only add to the end.  decode_trace.py reads
+// the names from here; the comments say what a and b hold.
+typedef enum {
+  trace_start = 0,    // a: TRACE_LEVEL, b: TRACE_RECORDS
+  trace_stop,         //
+  trace_tick,         // a: TimeUnits changed
+  trace_choose,       // a: EventState, b: catalog index
+  trace_sync,         // a: 1 if it changed anything, b: AppSync key
+  trace_setting,      // a: 1 enabled, 0 disabled, b: event id
+  trace_battery,      // a: charge percent, b: 1 charging, 2 plugged
+  trace_bluetooth,    // a: 1 connected
+  trace_event_count
+} TraceEvent;
+
+typedef struct __attribute__((__packed__)) {
+  uint32_t time;
+  uint8_t  event;
+  uint8_t  a;
+  uint16_t b;
+} TraceRecord;
+
+typedef struct __attribute__((__packed__)) {
+  uint8_t     version;
+  // next record to write, and how many of them are in use
+  uint8_t     head;
+  uint8_t     count;
+  uint8_t     level;
+  TraceRecord records[TRACE_RECORDS];
+} TraceRing;
+
+#if TRACE_LEVEL > TRACE_LEVEL_OFF
+
+#define TRACE_INIT()                  trace_init()
+#define TRACE_FLUSH()                 trace_flush()
+#define TRACE_DUMP()                  trace_dump()
+#define TRACE(event, a, b)            trace_record((event), (a), (b))
+
+void trace_init(void);
+// writes the ring to persist
+void trace_flush(void);
+// logs the ring, earlier runs included, as hex
+void trace_dump(void);
+void trace_record(TraceEvent event, uint8_t a, uint16_t b);
+
+#else
+
+#define TRACE_INIT()                  ((void)0)
+#define TRACE_FLUSH()                 ((void)0)
+#define TRACE_DUMP()                  ((void)0)
+#define TRACE(event, a, b)            ((void)0)
+
+#endif
+
+#if TRACE_LEVEL >= TRACE_LEVEL_TICKS
+#define TRACE_TICK(units)             trace_record(trace_tick, (units), 0)
+#else
+#define TRACE_TICK(units)             ((void)0)
+#endif
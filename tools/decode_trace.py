@@ -0,0 +1,114 @@
+#!/usr/bin/env python
+#
+#  file: decode_trace.py
+#  Turns the face's trace ring (see src/trace.h) back into a timeline
+#
+#  A face built with TRACE_LEVEL above 0 logs its ring once a launch as
+#  "trace <line>/<lines> <hex>" lines, so
+#      pebble logs > watch.log
+#      tools/decode_trace.py watch.log
+#  decodes the last complete dump in the log.  --raw FILE takes the
+#  persisted bytes themselves instead, e.g. from the host replay's
+#  --trace option.
+#
+#  Event names come from the TraceEvent enum in src/trace.h, in order;
+#  the per-event argument formats below follow its comments.  Times are
+#  shown in UTC.
+
+import os
+import re
+import struct
+import sys
+import time
+
+HEADER = struct.Struct('<BBBB')
+RECORD = struct.Struct('<IBBH')
+TRACE_H = os.path.join(os.path.dirname(os.path.abspath(__file__)), '..', 'src', 'trace.h')
+
+UNITS = ['sec', 'min', 'hour', 'day', 'month', 'year']
+STATES = ['counting', 'on', 'over']
+
+
+def units(mask):
+    return '|'.join(name for bit, name in enumerate(UNITS) if mask & (1 << bit)) or '-'
+
+
+ARGS = {
+    'start':     lambda a, b: 'level %d, %d records' % (a, b),
+    'stop':      lambda a, b: '',
+    'tick':      lambda a, b: units(a),
+    'choose':    lambda a, b: 'index %d %s' % (b, STATES[a] if a < len(STATES) else a),
+    'sync':      lambda a, b: 'key %d%s' % (b, ' changed' if a else ''),
+    'setting':   lambda a, b: 'event %d %s' % (b, 'on' if a else 'off'),
+    'battery':   lambda a, b: '%d%%%s%s' % (a, ' charging' if b & 1 else '', ' plugged' if b & 2 else ''),
+    'bluetooth': lambda a, b: 'connected' if a else 'disconnected',
+}
+
+
+def read_header(path=TRACE_H):
+    with open(path) as f:
+        text = f.read()
+    body = re.search(r'typedef enum \{(.*?)\} TraceEvent;', text, re.S).group(1)
+    names = re.findall(r'^\s*trace_(\w+)', body, re.M)
+    names.remove('event_count')
+    version = int(re.search(r'#define TRACE_VERSION\s+(\d+)', text).group(1))
+    records = int(re.search(r'#define TRACE_RECORDS\s+(\d+)', text).group(1))
+    return names, version, records
+
+
+def from_log(lines):
+    """bytes of the last complete dump in the log lines, or None"""
+    found = None
+    parts = {}
+    for line in lines:
+        m = re.search(r'trace (\d+)/(\d+) ([0-9a-f]+)\s*$', line)
+        if not m:
+            continue
+        n, total = int(m.group(1)), int(m.group(2))
+        if n == 1:
+            parts = {}
+        parts[n] = m.group(3)
+        if n == total and sorted(parts) == list(range(1, total + 1)):
+            found = bytes(bytearray.fromhex(''.join(parts[i] for i in range(1, total + 1))))
+    return found
+
+
+def decode(blob, names, version, capacity):
+    if len(blob) < HEADER.size + capacity * RECORD.size:
+        raise ValueError('%d bytes is too short for a ring of %d' % (len(blob), capacity))
+    ring_version, head, count, level = HEADER.unpack_from(blob)
+    if ring_version != version:
+        raise ValueError('ring version %d, expected %d' % (ring_version, version))
+    records = [RECORD.unpack_from(blob, HEADER.size + i * RECORD.size) for i in range(capacity)]
+    # oldest first: the ring is full from head round, or starts at 0
+    order = list(range(head, capacity)) + list(range(head)) if count == capacity else list(range(count))
+    rows = []
+    for i in order:
+        when, event, a, b = records[i]
+        name = names[event] if event < len(names) else 'event%d' % event
+        args = ARGS.get(name, lambda a, b: 'a %d b %d' % (a, b))(a, b)
+        rows.append('%s  %-10s %s' % (time.strftime('%Y-%m-%d %H:%M:%S', time.gmtime(when)), name, args))
+    return level, rows
+
+
+def main(argv):
+    if len(argv) == 3 and argv[1] == '--raw':
+        with open(argv[2], 'rb') as f:
+            blob = f.read()
+    elif len(argv) <= 2:
+        f = open(argv[1]) if len(argv) == 2 else sys.stdin
+        blob = from_log(f)
+        if blob is None:
+            sys.exit('no complete trace dump found')
+    else:
+        sys.exit('usage: decode_trace.py [watch.log] | --raw trace.bin')
+
+    names, version, capacity = read_header()
+    level, rows = decode(blob, names, version, capacity)
+    print('trace level %d, %d records' % (level, len(rows)))
+    for row in rows:
+        print(row)
+
+
+if __name__ == '__main__':
+    main(sys.argv)
@@ -0,0 +1,189 @@
+#!/usr/bin/env python
+#
+#  file: make_atlas.py
+#  Packs the indicator images into one atlas resource
+#
+#  The battery, Bluetooth and AM/PM images in resources/images/ are packed
+#  into resources/images/indicators.png.  Their rectangles go into
+#  src/atlas.h, and countdown.c cuts them out of the one loaded bitmap with
+#  gbitmap_create_as_sub_bitmap().
+#
+#  Aplite ANDs the 1-bit atlas over the background.  Colour platforms
+#  can't AND, so they get indicators-color.png, the same atlas with white
+#  made transparent, and draw it with GCompOpSet.
+#
+#  Only 8-bit grey, grey+alpha, RGB and RGBA PNGs are read; the SDK turns
+#  the atlas into the watch's own bitmap format like any other png resource.
+
+import os
+import struct
+import sys
+import zlib
+
+# atlas order: (name in atlas.h, source image)
+SPRITES = [
+    ('AMPM_PM',           'ampm_pm.png'),
+    ('AMPM_AM',           'ampm_am.png'),
+    ('AMPM_BLANK',        'ampm_blank.png'),
+    ('BT_DISCONNECTED',   'btdisconnected.png'),
+    ('BT_CONNECTED',      'btconnected.png'),
+    ('BATTERY_BASIC',     'basic.png'),
+    ('BATTERY_CHARGING',  'charging.png'),
+    ('BATTERY_CONNECTED', 'full.png'),
+    ('BATTERY_100',       'charge6.png'),
+    ('BATTERY_80',        'charge5.png'),
+    ('BATTERY_60',        'charge4.png'),
+    ('BATTERY_40',        'charge3.png'),
+    ('BATTERY_20',        'charge2.png'),
+    ('BATTERY_EMPTY',     'empty.png'),
+]
+
+CHANNELS = {0: 1, 2: 3, 4: 2, 6: 4}
+
+
+def read_png(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:8] != b'\x89PNG\r\n\x1a\n':
+        raise ValueError('%s: not a PNG' % path)
+    pos = 8
+    idat = b''
+    while pos < len(data):
+        length, kind = struct.unpack('>I4s', data[pos:pos + 8])
+        body = data[pos + 8:pos + 8 + length]
+        if kind == b'IHDR':
+            width, height, depth, colour, _, _, interlace = struct.unpack('>IIBBBBB', body)
+            if depth != 8 or colour not in CHANNELS or interlace:
+                raise ValueError('%s: unsupported PNG format' % path)
+        elif kind == b'IDAT':
+            idat += body
+        pos += 12 + length
+
+    channels = CHANNELS[colour]
+    stride = width * channels
+    raw = bytearray(zlib.decompress(idat))
+    rows = []
+    prev = bytearray(stride)
+    for y in range(height):
+        kind = raw[y * (stride + 1)]
+        line = raw[y * (stride + 1) + 1:(y + 1) * (stride + 1)]
+        for x in range(stride):
+            a = line[x - channels] if x >= channels else 0
+            b = prev[x]
+            c = prev[x - channels] if x >= channels else 0
+            if kind == 1:
+                line[x] = (line[x] + a) & 0xFF
+            elif kind == 2:
+                line[x] = (line[x] + b) & 0xFF
+            elif kind == 3:
+                line[x] = (line[x] + ((a + b) >> 1)) & 0xFF
+            elif kind == 4:
+                p = a + b - c
+                pa, pb, pc = abs(p - a), abs(p - b), abs(p - c)
+                pred = a if pa <= pb and pa <= pc else (b if pb <= pc else c)
+                line[x] = (line[x] + pred) & 0xFF
+        prev = line
+        # normalise to RGBA
+        rgba = bytearray()
+        for x in range(width):
+            px = line[x * channels:(x + 1) * channels]
+            if channels == 1:
+                rgba += bytearray([px[0], px[0], px[0], 255])
+            elif channels == 2:
+                rgba += bytearray([px[0], px[0], px[0], px[1]])
+            elif channels == 3:
+                rgba += px + bytearray([255])
+            else:
+                rgba += px
+        rows.append(rgba)
+    return width, height, rows
+
+
+def chunk(kind, body):
+    return (struct.pack('>I', len(body)) + kind + body +
+            struct.pack('>I', zlib.crc32(kind + body) & 0xFFFFFFFF))
+
+
+def write_png(path, width, rows):
+    raw = b''.join(b'\0' + bytes(row) for row in rows)
+    with open(path, 'wb') as f:
+        f.write(b'\x89PNG\r\n\x1a\n')
+        f.write(chunk(b'IHDR', struct.pack('>IIBBBBB', width, len(rows), 8, 6, 0, 0, 0)))
+        f.write(chunk(b'IDAT', zlib.compress(raw, 9)))
+        f.write(chunk(b'IEND', b''))
+
+
+def pack(sizes, width):
+    """Shelf packing: each shelf is a row of columns, and sprites of one width
+    stack in a column while they fit under the shelf's first sprite.
+    Returns the sprite origins and the atlas height, or None."""
+    order = sorted(range(len(sizes)), key=lambda i: (-sizes[i][1], -sizes[i][0]))
+    origins = [None] * len(sizes)
+    shelf_y = shelf_h = shelf_x = 0
+    columns = []  # [x, width, used height] in the current shelf
+    for i in order:
+        w, h = sizes[i]
+        if w > width:
+            return None
+        for column in columns:
+            if column[1] == w and column[2] + h <= shelf_h:
+                origins[i] = (column[0], shelf_y + column[2])
+                column[2] += h
+                break
+        else:
+            if not columns or shelf_x + w > width:
+                shelf_y += shelf_h
+                shelf_h = h
+                shelf_x = 0
+                columns = []
+            columns.append([shelf_x, w, h])
+            origins[i] = (shelf_x, shelf_y)
+            shelf_x += w
+    return origins, shelf_y + shelf_h
+
+
+# white pixels become transparent, everything else stays as it is
+def transparent_white(rows):
+    result = []
+    for row in rows:
+        row = bytearray(row)
+        for x in range(0, len(row), 4):
+            if row[x] >= 0x80 and row[x + 1] >= 0x80 and row[x + 2] >= 0x80:
+                row[x:x + 4] = b'\xff\xff\xff\x00'
+        result.append(row)
+    return result
+
+
+def build(image_dir, atlas_png, atlas_header, color_png=None):
+    images = [(name, read_png(os.path.join(image_dir, source))) for name, source in SPRITES]
+    sizes = [(w, h) for _, (w, h, _) in images]
+
+    # the watch stores 1-bit rows padded to 32 pixels, so pick the atlas
+    # width that needs the fewest bytes
+    best = None
+    for width in range(32, 32 * 5, 32):
+        packed = pack(sizes, width)
+        if packed and (best is None or width * packed[1] < best[0] * best[2]):
+            best = (width, packed[0], packed[1])
+    width, origins, height = best
+
+    rows = [bytearray(4 * width) for _ in range(height)]
+    for (name, (w, h, pixels)), (x, y) in zip(images, origins):
+        for dy, line in enumerate(pixels):
+            rows[y + dy][4 * x:4 * (x + w)] = line
+    write_png(atlas_png, width, rows)
+    if color_png:
+        write_png(color_png, width, transparent_white(rows))
+
+    with open(atlas_header, 'w') as f:
+        f.write('#pragma once\n\n')
+        f.write('// Sprite rectangles in the INDICATOR_ATLAS resource.\n')
+        f.write('// Generated by tools/make_atlas.py, do not edit.\n\n')
+        for (name, (w, h, _)), (x, y) in zip(images, origins):
+            f.write('#define ATLAS_%-18s GRect(%2d, %2d, %2d, %2d)\n' % (name, x, y, w, h))
+
+
+if __name__ == '__main__':
+    if len(sys.argv) not in (4, 5):
+        sys.exit('usage: make_atlas.py image_dir atlas.png atlas.h [atlas-color.png]')
+    build(*sys.argv[1:])
@@ -0,0 +1,239 @@
+#!/usr/bin/env python
+#
+#  file: make_catalog.py
+#  Packs resources/data/events.json into the EVENT_CATALOG resource blob,
+#  and generates src/settings_schema.h, src/js/settings_schema.js and the
+#  companion's copy of the catalog, src/js/event_catalog.js, from the same
+#  file
+#
+#  Start is the first day as a local calendar date, "YYYY-MM-DD", and
+#  length is the number of days in the event, counting first and last.
+#  Dates stay dates all the way to the watch, which counts days with its
+#  own local clock, so an event starts at midnight in every time zone.
+#
+#  Don't change the ID of any event, the watch keeps its settings by ID.
+#  New events get the next free ID.  Each event occurs only ONCE, so for
+#  next year's event keep the ID and change the start.  Records are
+#  sorted by start here, so the order in events.json doesn't matter.
+#  If an event goes away for a year set its start to "1970-01-01"; if it
+#  really goes away set it to "9999-12-31" so it sorts after the "MINI"
+#  event (ID 255, "9999-12-30"), which the watch never looks past.
+#  The watch binary searches on finish day (start + length + 1), so an
+#  event may not finish before the one starting ahead of it.
+#
+#  An event the user can turn on and off has a "setting": its key in the
+#  configuration page and in AppSync, and its bit in the packed settings.
+#  Keys run 1..N without gaps and belong to one ID each; every record of
+#  that ID carries the same key.  Don't renumber them, the companion and
+#  older watches know them.  The settings header holds the Settings enum,
+#  the key -> event id table and the AppSync tuple initializer, all const.
+#  The JS list gives the companion each setting's key, event id, name and
+#  title (from the latest record of its ID) for the configuration page.
+#
+#  The companion streams events to the watch from its own copy of the
+#  catalog (see src/stream.h): every record but the DUMMY ones, sorted the
+#  same way, with the same version.  Streamed names have 24 bytes, NUL
+#  included, so names are kept to 23 characters.
+#
+#  Layout, all little endian (see src/catalog.h):
+#    header   magic "MEVC", u16 format version, u16 record count,
+#             u32 schedule version (CRC32 of everything after the header),
+#             u16 name table size, u16 reserved
+#    records  u32 first day (days from 1970-01-01), u8 id, u8 length,
+#             u16 name offset; sorted by first day
+#    names    NUL terminated, each distinct name stored once
+
+import datetime
+import json
+import re
+import struct
+import sys
+import zlib
+
+MAGIC = b'MEVC'
+FORMAT_VERSION = 2
+HEADER = struct.Struct('<4sHHIHH')
+RECORD = struct.Struct('<IBBH')
+NAME_MAX = 23
+EPOCH = datetime.date(1970, 1, 1)
+
+
+def day(e):
+    """the event's first day, counted from 1970-01-01"""
+    try:
+        return (datetime.datetime.strptime(e['start'], '%Y-%m-%d').date() - EPOCH).days
+    except (TypeError, ValueError):
+        raise ValueError('%s: start must be a date, "YYYY-MM-DD"' % e['name'])
+
+
+def finish(e):
+    return day(e) + e['length'] + 1
+
+
+def check(events):
+    ids = set()
+    for e in events:
+        if not 0 <= e['id'] <= 255 or e['id'] in ids:
+            raise ValueError('bad or duplicate id %r' % e['id'])
+        ids.add(e['id'])
+        if day(e) < 0:
+            raise ValueError('%s: start before 1970' % e['name'])
+        if not 0 <= e['length'] <= 255:
+            raise ValueError('%s: length out of range' % e['name'])
+        if not 0 < len(e['name']) <= NAME_MAX:
+            raise ValueError('%s: name must be 1..%d characters' % (e['name'], NAME_MAX))
+
+    events = sorted(events, key=lambda e: (day(e), e['length']))
+    last = None
+    for e in events:
+        if last is not None and finish(e) < finish(last):
+            raise ValueError('%s finishes before %s' % (e['name'], last['name']))
+        if e['id'] == 255:
+            break
+        last = e
+    return events
+
+
+def pack(events):
+    events = check(events)
+    names = b''
+    offsets = {}
+    records = b''
+    for e in events:
+        name = e['name'].encode('ascii')
+        if name not in offsets:
+            offsets[name] = len(names)
+            names += name + b'\0'
+        records += RECORD.pack(day(e), e['id'], e['length'], offsets[name])
+
+    body = records + names
+    serial = zlib.crc32(body) & 0xFFFFFFFF
+    return HEADER.pack(MAGIC, FORMAT_VERSION, len(events), serial, len(names), 0) + body
+
+
+def settings(events):
+    """(key, name, id) for every setting, in key order"""
+    by_key = {}
+    by_id = {}
+    for e in events:
+        if 'setting' not in e:
+            continue
+        key = e['setting']
+        if not re.match(r'^[A-Za-z_][A-Za-z0-9_]*$', e['name']):
+            raise ValueError('%s: a setting name must be a C identifier' % e['name'])
+        if e['id'] in (0, 255):
+            raise ValueError('%s: the placeholder events have no setting' % e['name'])
+        if by_id.setdefault(e['id'], key) != key:
+            raise ValueError('id %d has settings %d and %d' % (e['id'], by_id[e['id']], key))
+        if by_key.setdefault(key, (key, e['name'], e['id']))[2] != e['id']:
+            raise ValueError('setting %d belongs to ids %d and %d' % (key, by_key[key][2], e['id']))
+    if sorted(by_key) != list(range(1, len(by_key) + 1)):
+        raise ValueError('setting keys must run 1..%d' % len(by_key))
+    if len(by_key) > 99:
+        raise ValueError('the SETTINGS_PACKED_KEY tuple (100) is in the way')
+    return [by_key[key] for key in sorted(by_key)]
+
+
+def settings_header(events):
+    rows = settings(events)
+    width = max(len(name) for _, name, _ in rows)
+    lines = [
+        '#pragma once',
+        '',
+        '// Event settings: configuration page/AppSync key, name and event id.',
+        '// Generated by tools/make_catalog.py from resources/data/events.json,',
+        '// do not edit.',
+        '',
+        'enum Settings {',
+    ]
+    for key, name, _ in rows:
+        lines.append('  %-*s = %2d,' % (width + 8, 'setting_' + name, key))
+    lines += [
+        '  setting_count',
+        '};',
+        '',
+        '// event id each setting turns on and off',
+        'static const uint8_t setting_event_id[setting_count] = {',
+    ]
+    for key, name, event_id in rows:
+        lines.append('  %-*s = %3d,' % (width + 10, '[setting_' + name + ']', event_id))
+    lines += [
+        '};',
+        '',
+        '// AppSync initial tuples, one per setting; enabled(key) gives the',
+        '// current value',
+        '#define SETTINGS_TUPLETS(enabled) \\',
+    ]
+    for i, (key, name, _) in enumerate(rows):
+        tail = ' \\' if i + 1 < len(rows) else ''
+        lines.append('  TupletInteger(%-*s enabled(%s)),%s' %
+                     (width + 9, 'setting_' + name + ',', 'setting_' + name, tail))
+    return '\n'.join(lines) + '\n'
+
+
+def settings_js(events):
+    latest = {}
+    for e in sorted(events, key=day):
+        latest[e['id']] = e
+    lines = [
+        '//  Event settings for the configuration page: key, event id, name and',
+        '//  title.',
+        '//  Generated by tools/make_catalog.py from resources/data/events.json,',
+        '//  do not edit.',
+        '',
+        'var eventSettings = [',
+    ]
+    rows = settings(events)
+    for i, (key, name, event_id) in enumerate(rows):
+        lines.append('  { key: %d, id: %d, name: %s, title: %s }%s' %
+                     (key, event_id, json.dumps(name), json.dumps(latest[event_id].get('title', name)),
+                      ',' if i + 1 < len(rows) else ''))
+    lines.append('];')
+    return '\n'.join(lines) + '\n'
+
+
+def catalog_js(events, version):
+    lines = [
+        '//  The whole event catalog, which the companion streams to the watch a',
+        '//  few events at a time.  Generated by tools/make_catalog.py from',
+        '//  resources/data/events.json, do not edit.',
+        '',
+        'var eventCatalog = {',
+        '  version: %d,' % version,
+        '  // first day (days from 1970-01-01, local), id, length, name;',
+        '  // sorted by first day',
+        '  events: [',
+    ]
+    rows = [e for e in check(events) if e['id'] != 0]
+    for i, e in enumerate(rows):
+        lines.append('    [%d, %d, %d, %s]%s' % (day(e), e['id'], e['length'], json.dumps(e['name']),
+                                               ',' if i + 1 < len(rows) else ''))
+    lines += [
+        '  ]',
+        '};',
+    ]
+    return '\n'.join(lines) + '\n'
+
+
+def build(source, target, header=None, script=None, catalog_script=None):
+    with open(source) as f:
+        events = json.load(f)
+    blob = pack(events)
+    outputs = [(target, blob, 'wb')]
+    if header:
+        outputs.append((header, settings_header(events), 'w'))
+    if script:
+        outputs.append((script, settings_js(events), 'w'))
+    if catalog_script:
+        version = HEADER.unpack_from(blob)[3]
+        outputs.append((catalog_script, catalog_js(events, version), 'w'))
+    for path, data, mode in outputs:
+        with open(path, mode) as f:
+            f.write(data)
+
+
+if __name__ == '__main__':
+    if len(sys.argv) not in (3, 4, 5, 6):
+        sys.exit('usage: make_catalog.py events.json events.bin '
+                 '[settings_schema.h [settings_schema.js [event_catalog.js]]]')
+    build(*sys.argv[1:])